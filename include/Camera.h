@@ -24,6 +24,12 @@ namespace Dwarf
 		void setRotation(glm::vec3 rotation);
         void setCameraSpeed(float movementSpeed);
 		const glm::mat4 &getMVP() const;
+		const glm::mat4 &getView() const;
+		const glm::mat4 &getProjection() const;
+		float getNear() const;
+		float getFar() const;
+		glm::vec3 getEyePosition() const;
+		float getFov() const;
 
 		bool _left;
 		bool _right;
@@ -7,30 +7,40 @@
 #include "Tools.h"
 #include "IBuildable.h"
 #include "ThreadPool.h"
+#include "CullingManager.h"
+#include "RenderQueue.h"
 
 namespace Dwarf
 {
     class CommandBuffersBuilder
     {
     public:
-        CommandBuffersBuilder(const vk::Device &device, const vk::RenderPass &renderPass, std::vector<vk::Framebuffer> &swapChainFramebuffers, const vk::Extent2D &swapChainExtent, ThreadPool &threadPool, const uint32_t &numThreads);
+        CommandBuffersBuilder(const vk::Device &device, const vk::RenderPass &renderPass, const vk::RenderPass &renderPassLoad, std::vector<vk::Framebuffer> &swapChainFramebuffers, const vk::Extent2D &swapChainExtent, ThreadPool &threadPool, const uint32_t &numThreads);
         virtual ~CommandBuffersBuilder();
         void createCommandPools(const uint32_t &graphicsFamily);
-        void createCommandBuffers(const vk::Queue &graphicsQueue, vk::PhysicalDeviceMemoryProperties &memProperties);
-        void buildCommandBuffers(const std::vector<vk::CommandBuffer> &commandBuffers, const glm::mat4 &mvp);
+        /// \brief Upload the buffers of the buildables, once they are all added
+        void createBuildableBuffers(const vk::Queue &graphicsQueue, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        /// \brief Allocate the secondary command buffers, again only when the swap chain image count changes
+        void createCommandBuffers();
+        void buildCommandBuffers(const std::vector<vk::CommandBuffer> &commandBuffers, const glm::mat4 &mvp, CullingManager &cullingManager);
         void addBuildable(IBuildable *buildable);
         void addBuildables(std::vector<IBuildable *> &buildables);
 
     private:
+        void recordDraws(const vk::CommandBuffer &commandBuffer, const vk::CommandBufferInheritanceInfo &inheritanceInfo, const glm::mat4 &mvp, size_t begin, size_t end) const;
+
         const vk::Device &_device;
         const vk::RenderPass &_renderPass;
+        const vk::RenderPass &_renderPassLoad;
         std::vector<vk::Framebuffer> &_swapChainFramebuffers;
         const vk::Extent2D &_swapChainExtent;
         ThreadPool &_threadPool;
         const uint32_t &_numThreads;
         std::vector<IBuildable *> _buildables;
-        std::vector<std::vector<IBuildable *>> _orderedBuildables;
         std::vector<vk::CommandPool> _commandPools;
+        /// One secondary command buffer per thread and swap chain image, each recording a contiguous range of the sorted draws
+        std::vector<std::vector<vk::CommandBuffer>> _secondaryCommandBuffers;
+        RenderQueue _renderQueue;
     };
 }
 
@@ -0,0 +1,150 @@
+#ifndef DWARF_CULLINGMANAGER_H_
+#define DWARF_CULLINGMANAGER_H_
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "Tools.h"
+#include "Mesh.h"
+#include "DepthPyramid.h"
+
+namespace Dwarf
+{
+    enum CullingPhase
+    {
+        EARLY,
+        LATE
+    };
+
+    /// \struct CullingInstance
+    /// \brief Per submesh data read by the culling compute shader (std430 layout)
+    struct CullingInstance
+    {
+        glm::mat4 transform;
+        glm::vec4 boundingSphere;
+        glm::uvec4 lodFirstIndex;
+        glm::uvec4 lodIndexCount;
+        glm::vec4 lodError;
+        uint32_t lodCount;
+        uint32_t meshletIndexOffset;
+        uint32_t meshletCount;
+        uint32_t padding;
+    };
+
+    /// \struct CullingMeshlet
+    /// \brief Per meshlet data read by the meshlet culling compute shader (std430 layout)
+    struct CullingMeshlet
+    {
+        glm::vec4 boundingSphere;
+        glm::vec4 cone;
+        uint32_t instance;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t padding;
+    };
+
+    /// \struct CullingUniformBuffer
+    /// \brief Per frame data of the culling compute shader (std140 layout)
+    struct CullingUniformBuffer
+    {
+        glm::mat4 viewProjection;
+        std::array<glm::vec4, 6> frustumPlanes;
+        glm::vec4 cameraPosition;
+        glm::vec2 pyramidSize;
+        uint32_t instanceCount;
+        uint32_t occlusionCulling;
+        float lodScale;
+        float lodThreshold;
+        uint32_t meshletCount;
+        uint32_t padding;
+    };
+
+    /// \class CullingManager
+    /// \brief GPU frustum and Hi-Z occlusion culling feeding the indirect draws of every submesh
+    ///
+    /// Each registered submesh owns one vk::DrawIndexedIndirectCommand slot. The compute pass
+    /// writes instanceCount 0 or 1 in that slot and compacts the indices of the surviving
+    /// submeshes in a visibility list with an atomic counter.
+    /// Culling runs in two phases: the early phase draws what was visible last frame, the depth
+    /// pyramid is built from that depth, then the late phase tests every instance against it,
+    /// draws the disoccluded ones and stores the visibility for the next frame.
+    /// The same pass selects the level of detail of every submesh from its projected error.
+    /// Submeshes split in meshlets own a second slot: when drawn at their finest level, a second
+    /// dispatch culls every meshlet against the frustum and its normal cone and compacts the
+    /// indices of the survivors in a per submesh range of the meshlet index buffer.
+    class CullingManager
+    {
+    public:
+        CullingManager(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator);
+        virtual ~CullingManager();
+        /// \brief Register every submesh of the meshes and create the GPU resources
+        void build(std::vector<Mesh *> &meshes);
+        /// \brief (Re)create the depth pyramid for the depth attachment
+        void createDepthPyramid(const vk::ImageView &depthImageView, const vk::Extent2D &depthExtent);
+        /// \brief Upload the current transform of every instance
+        void update();
+        /// \brief Record the culling dispatch of a phase, must be outside of a render pass
+        void recordCulling(const vk::CommandBuffer &commandBuffer, const glm::mat4 &viewProjection, CullingPhase phase);
+        /// \brief Record the depth pyramid reduction, between the early and the late render passes
+        void recordDepthPyramid(const vk::CommandBuffer &commandBuffer);
+        /// \brief Reference frustum culler running the same tests as the compute shader
+        void cullOnCpu(const std::array<glm::vec4, 6> &frustumPlanes, std::vector<uint32_t> &visibleInstances) const;
+        /// \brief Compare the last GPU visibility list with the CPU reference, the queue must be idle
+        ///
+        /// With occlusion culling enabled the GPU list must be a subset of the frustum culled one.
+        bool validate() const;
+        void setOcclusionCulling(bool occlusionCulling);
+        /// \brief Camera used to project the error of the levels of detail, fov in degrees
+        void setLodSelection(const glm::vec3 &cameraPosition, float fov, float viewportHeight);
+        /// \brief Largest projected error in pixels tolerated before switching to a finer level of detail
+        void setLodThreshold(float lodThreshold);
+        uint32_t getVisibleCount() const;
+        uint32_t getInstanceCount() const;
+        static std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4 &viewProjection);
+
+    private:
+        void createBuffers();
+        void createDescriptorSet();
+        void createPipelines();
+        vk::Pipeline createComputePipeline(const std::string &shaderPath) const;
+
+        const vk::Device &_device;
+        const vk::PhysicalDeviceMemoryProperties _memProperties;
+        PipelineCache &_pipelineCache;
+        ShaderLibrary &_shaderLibrary;
+        DescriptorAllocator &_descriptorAllocator;
+        DepthPyramid _depthPyramid;
+        std::vector<Submesh *> _submeshes;
+        std::vector<CullingInstance> _instances;
+        std::vector<CullingMeshlet> _meshlets;
+        CullingUniformBuffer _uniformBuffer;
+        vk::Buffer _instanceBuffer;
+        vk::DeviceMemory _instanceBufferMemory;
+        vk::Buffer _drawCommandBuffer;
+        vk::DeviceMemory _drawCommandBufferMemory;
+        vk::Buffer _visibilityBuffer;
+        vk::DeviceMemory _visibilityBufferMemory;
+        vk::Buffer _historyBuffer;
+        vk::DeviceMemory _historyBufferMemory;
+        vk::Buffer _meshletBuffer;
+        vk::DeviceMemory _meshletBufferMemory;
+        vk::Buffer _meshletIndexBuffer;
+        vk::DeviceMemory _meshletIndexBufferMemory;
+        vk::Buffer _sourceIndexBuffer;
+        uint32_t _meshletIndexCount;
+        vk::Buffer _cullingUniformBuffer;
+        vk::DeviceMemory _cullingUniformBufferMemory;
+        void *_mappedInstances;
+        uint32_t *_mappedVisibility;
+        void *_mappedUniformBuffer;
+        vk::DescriptorSetLayout _descriptorSetLayout;
+        vk::DescriptorSet _descriptorSet;
+        vk::PipelineLayout _pipelineLayout;
+        vk::Pipeline _pipeline;
+        vk::Pipeline _meshletPipeline;
+    };
+}
+
+#endif // DWARF_CULLINGMANAGER_H_
@@ -0,0 +1,73 @@
+#ifndef DWARF_DEPTHPYRAMID_H_
+#define DWARF_DEPTHPYRAMID_H_
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "Tools.h"
+#include "DescriptorAllocator.h"
+#include "PipelineCache.h"
+#include "ShaderLibrary.h"
+
+namespace Dwarf
+{
+    /// \class DepthPyramid
+    /// \brief Hierarchical-Z buffer built from the depth attachment
+    ///
+    /// Every texel of a level holds the farthest depth of the texels it covers in the level above,
+    /// so testing a bounding rectangle against a few texels of the right level is conservative.
+    class DepthPyramid
+    {
+    public:
+        DepthPyramid(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator);
+        virtual ~DepthPyramid();
+        /// \brief (Re)create the pyramid for a depth attachment, its view must be sampleable
+        void create(const vk::ImageView &depthImageView, const vk::Extent2D &depthExtent);
+        /// \brief Record the reduction of every level, the depth must be in eDepthStencilReadOnlyOptimal
+        ///
+        /// The per level sets are transient, the command buffer has to be submitted within the frame.
+        void recordBuild(const vk::CommandBuffer &commandBuffer);
+        const vk::DescriptorImageInfo &getDescriptorImageInfo() const;
+        glm::vec2 getSize() const;
+
+    private:
+        struct PushConstants
+        {
+            uint32_t inputWidth;
+            uint32_t inputHeight;
+            uint32_t outputWidth;
+            uint32_t outputHeight;
+        };
+
+        void createPipeline();
+        void cleanup();
+
+        const vk::Device &_device;
+        const vk::PhysicalDeviceMemoryProperties _memProperties;
+        const vk::Queue &_graphicsQueue;
+        const vk::CommandPool &_commandPool;
+        PipelineCache &_pipelineCache;
+        ShaderLibrary &_shaderLibrary;
+        DescriptorAllocator &_descriptorAllocator;
+        vk::Image _image;
+        vk::DeviceMemory _imageMemory;
+        vk::ImageView _imageView;
+        std::vector<vk::ImageView> _levelViews;
+        std::vector<PushConstants> _levelSizes;
+        vk::Sampler _sampler;
+        vk::DescriptorImageInfo _imageInfo;
+        vk::DescriptorSetLayout _descriptorSetLayout;
+        vk::ImageView _depthImageView;
+        vk::PipelineLayout _pipelineLayout;
+        vk::Pipeline _pipeline;
+        uint32_t _width;
+        uint32_t _height;
+        uint32_t _mipLevels;
+    };
+}
+
+#endif // DWARF_DEPTHPYRAMID_H_
@@ -0,0 +1,84 @@
+#ifndef DWARF_DESCRIPTORALLOCATOR_H_
+#define DWARF_DESCRIPTORALLOCATOR_H_
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Tools.h"
+
+// Sets of the first pool of a chain, every new pool of the chain holds twice as many
+#define DWARF_DESCRIPTOR_POOL_SETS 64
+#define DWARF_DESCRIPTOR_POOL_MAX_SETS 4096
+
+namespace Dwarf
+{
+    /// \class DescriptorAllocator
+    /// \brief Descriptor sets from chained pools, a full pool is never an error
+    ///
+    /// Without VK_KHR_maintenance1 allocating from an exhausted pool is undefined, the sets and descriptors
+    /// left in every pool are counted and the chain grows before a pool runs out. Layouts are registered with
+    /// their bindings for their descriptor counts.
+    /// Persistent sets are recycled per layout once freed, their descriptors have to be written again.
+    /// Transient sets live for a single frame, the pools of a frame are reset in bulk when it comes back.
+    class DescriptorAllocator
+    {
+    public:
+        DescriptorAllocator(const vk::Device &device, uint32_t frameCount);
+        virtual ~DescriptorAllocator();
+        /// \brief Thread safe, required before allocating sets of the layout
+        void addLayout(const vk::DescriptorSetLayout &layout, const std::vector<vk::DescriptorSetLayoutBinding> &bindings);
+        /// \brief Thread safe
+        vk::DescriptorSet allocate(const vk::DescriptorSetLayout &layout);
+        /// \brief Hand a persistent set back, it must not be used by a pending command buffer anymore
+        void free(const vk::DescriptorSetLayout &layout, const vk::DescriptorSet &descriptorSet);
+        /// \brief Thread safe, valid until the same frame begins again
+        vk::DescriptorSet allocateTransient(const vk::DescriptorSetLayout &layout);
+        /// \brief Move to the next frame and reset its transient pools, the GPU must be done with that frame
+        void beginFrame();
+
+    private:
+        /// Descriptors per type, of a layout or left in a pool
+        typedef std::map<vk::DescriptorType, uint32_t> DescriptorCounts;
+
+        struct Pool
+        {
+            vk::DescriptorPool pool;
+            uint32_t setCount;
+            /// Left until the pool is reset
+            uint32_t sets;
+            DescriptorCounts descriptors;
+        };
+
+        struct PoolChain
+        {
+            PoolChain() : current(0), nextSetCount(DWARF_DESCRIPTOR_POOL_SETS) {}
+
+            std::vector<Pool> pools;
+            size_t current;
+            uint32_t nextSetCount;
+        };
+
+        vk::DescriptorSet allocate(PoolChain &chain, const vk::DescriptorSetLayout &layout);
+        /// \brief Whether the pool has a set and the descriptors of the layout left
+        static bool fits(const Pool &pool, const DescriptorCounts &layoutCounts);
+        vk::DescriptorSet allocate(Pool &pool, const vk::DescriptorSetLayout &layout, const DescriptorCounts &layoutCounts) const;
+        void addPool(PoolChain &chain);
+        /// \brief Make every set and descriptor of the pool available again
+        static void resetCounts(Pool &pool);
+        static std::vector<vk::DescriptorPoolSize> getPoolSizes(uint32_t setCount);
+        void destroy(PoolChain &chain);
+
+        const vk::Device &_device;
+        std::mutex _mutex;
+        PoolChain _persistentPools;
+        std::vector<PoolChain> _framePools;
+        uint32_t _frame;
+        std::unordered_map<VkDescriptorSetLayout, std::vector<vk::DescriptorSet>> _freeSets;
+        std::unordered_map<VkDescriptorSetLayout, DescriptorCounts> _layoutCounts;
+    };
+}
+
+#endif // DWARF_DESCRIPTORALLOCATOR_H_
@@ -12,15 +12,33 @@
 
 namespace Dwarf
 {
+    class RenderQueue;
+
+    /// \struct DrawState
+    /// \brief What is currently bound in a command buffer, so that sorted draws only bind what changes
+    struct DrawState
+    {
+        DrawState() : vertexBufferOffset(0), indexBufferOffset(0) {}
+
+        vk::Pipeline pipeline;
+        vk::PipelineLayout pipelineLayout;
+        vk::DescriptorSet descriptorSet;
+        vk::Buffer vertexBuffer;
+        vk::DeviceSize vertexBufferOffset;
+        vk::Buffer indexBuffer;
+        vk::DeviceSize indexBufferOffset;
+    };
+
     class IBuildable
     {
     public:
         virtual ~IBuildable() {}
         virtual void createBuffers(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::PhysicalDeviceMemoryProperties &memProperties) = 0;
-        virtual void buildCommandBuffer(const vk::CommandBufferInheritanceInfo &inheritanceInfo, const glm::mat4 &mvp, const vk::Extent2D &extent) const = 0;
+        /// \brief Push the draws of the buildable with their sort keys
+        virtual void enqueue(RenderQueue &renderQueue, const glm::mat4 &mvp) = 0;
+        /// \brief Record the draws in a secondary command buffer, binding only what differs from the state
+        virtual void recordDraw(const vk::CommandBuffer &commandBuffer, const glm::mat4 &mvp, DrawState &state) const = 0;
         virtual void setCommandPool(vk::CommandPool *commandPool) = 0;
-        virtual void setCommandBuffer(vk::CommandBuffer commandBuffer) = 0;
-        virtual vk::CommandBuffer getCommandBuffer() const = 0;
     };
 }
 
@@ -12,10 +12,13 @@
 
 namespace Dwarf
 {
-    struct LightUniformBuffer
+    /// \struct LightEntry
+    /// \brief One element of the light array of the lighting storage buffer (std430 layout)
+    struct LightEntry
     {
+        /// Range of the light in w
         glm::vec4 position;
-        glm::vec3 color;
+        glm::vec4 color;
     };
 
     class Light
@@ -32,15 +35,15 @@ namespace Dwarf
         void setColor(const Color &color);
         void changeRadius(double radius);
         void setRadius(double radius);
-        const LightUniformBuffer &getUniformBuffer() const;
+        const LightEntry &getEntry() const;
 
     private:
-        void updateUniformBuffer();
+        void updateEntry();
 
         glm::dvec3 _position;
         Color _color;
         double _radius;
-        LightUniformBuffer _uniformBuffer;
+        LightEntry _entry;
     };
 }
 
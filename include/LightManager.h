@@ -2,28 +2,70 @@
 #define DWARF_LIGHTMANAGER_H_
 #pragma once
 
+#include <vector>
+
 #include "Tools.h"
 #include "Light.h"
 
+// Sizes of the lighting storage buffer, shaders/lighting.glsl declares the same
+#define DWARF_MAX_LIGHTS 4096
+#define DWARF_CLUSTER_X 16
+#define DWARF_CLUSTER_Y 9
+#define DWARF_CLUSTER_Z 24
+#define DWARF_CLUSTER_COUNT (DWARF_CLUSTER_X * DWARF_CLUSTER_Y * DWARF_CLUSTER_Z)
+// Light indices of every cluster together, the lights past it are dropped from the clusters that overflow
+#define DWARF_MAX_CLUSTER_LIGHT_INDICES (DWARF_CLUSTER_COUNT * 64)
+
 namespace Dwarf
 {
+    /// \struct ClusterGrid
+    /// \brief Head of the lighting storage buffer, how the fragments find their cluster (std430 layout)
+    struct ClusterGrid
+    {
+        glm::mat4 view;
+        /// Clusters per pixel in x and y, scale and bias of the log2 of the view depth in z and w
+        glm::vec4 clusterScale;
+        /// Clusters along each axis, light count in w
+        glm::uvec4 clusterCount;
+    };
+
+    /// \class LightManager
+    /// \brief Point lights binned every frame in a 3D cluster grid over the view frustum, for clustered forward shading
+    ///
+    /// The grid splits the screen in tiles and the view depth in slices of exponential size. A single host visible
+    /// storage buffer holds the grid, the lights, the first index and count of the lights of every cluster, then
+    /// the light indices; fragments only iterate the lights of their cluster.
+    /// Lights are binned on the CPU against the screen bounds of their view space box, the grid is written
+    /// in place: a single frame is in flight.
     class LightManager
     {
     public:
         LightManager(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties);
         virtual ~LightManager();
         void buildDescriptorSet(const vk::PhysicalDeviceMemoryProperties &memProperties);
+        /// \brief Index of the new light, at most DWARF_MAX_LIGHTS lights
+        uint32_t addLight(const Light &light);
+        Light &getLight(uint32_t index);
+        uint32_t getLightCount() const;
         void updateLightPos(float elapsedTime);
+        /// \brief Bin the lights in the clusters of the camera and write the storage buffer, between two frames
+        void updateClusters(const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar, const vk::Extent2D &extent);
         const vk::DescriptorBufferInfo &getDescriptorBufferInfo() const;
 
     private:
+        /// \brief Slice of a view depth, the inverse of the slice boundaries of clusterScale
+        static uint32_t getSlice(float depth, const glm::vec4 &clusterScale);
+
         const vk::Device &_device;
         vk::DescriptorBufferInfo _descriptorBufferInfo;
         float _speed;
         float _angle;
-        Light _light;
+        std::vector<Light> _lights;
+        /// Lights of every cluster, kept between frames for their capacity
+        std::vector<std::vector<uint32_t>> _clusterLights;
+        bool _overflowed;
         vk::DeviceMemory _bufferMemory;
-        vk::Buffer _uniformBuffer;
+        vk::Buffer _storageBuffer;
         void *_mappedData;
     };
 }
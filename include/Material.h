@@ -2,95 +2,32 @@
 #define DWARF_MATERIAL_H_
 #pragma once
 
-#include <map>
+#include <array>
+#include <atomic>
 
 #include "Color.h"
-#include "Texture.h"
+#include "TextureManager.h"
 
 namespace Dwarf
 {
-	enum MaterialType
+	/// \brief Slot of a texture in a material
+	enum TextureSlot
 	{
-		AMBIENT,
-		DIFFUSE,
-		SPECULAR,
-		SPECULAR_HIGHLIGHT,
-		TRANSMITTANCE,
-		EMISSION,
-		SHININESS,
-		IOR,
-		DISSOLVE,
-		ILLUM,
-		CLEARCOAT_THICKNESS,
-		CLEARCOAT_ROUGHNESS,
-		ANISOTROPY,
-		ANISOTROPY_ROTATION,
-		BUMP,
-		DISPLACEMENT,
-		ALPHA,
-		ROUGHNESS,
-		METALLIC,
-		SHEEN,
-		EMISSIVE,
-		NORMAL
+		TEXTURE_AMBIENT,
+		TEXTURE_DIFFUSE,
+		TEXTURE_SPECULAR,
+		TEXTURE_SPECULAR_HIGHLIGHT,
+		TEXTURE_BUMP,
+		TEXTURE_DISPLACEMENT,
+		TEXTURE_ALPHA,
+		TEXTURE_ROUGHNESS,
+		TEXTURE_METALLIC,
+		TEXTURE_SHEEN,
+		TEXTURE_EMISSIVE,
+		TEXTURE_NORMAL,
+		TEXTURE_SLOT_COUNT
 	};
 
-	enum ValueType
-	{
-		COLOR,
-		FLOAT,
-		INT
-	};
-
-	union UnionValue
-	{
-		UnionValue(Color value) : c(value) {};
-		UnionValue(float value) : f(value) {};
-		UnionValue(int value) : i(value) {};
-		~UnionValue() {};
-		Color c;
-		float f;
-		int i;
-	};
-
-	struct Value
-	{
-		Value() : type(INT), value(0) {}
-		Value(ValueType t, Color c) : type(t), value(c) {}
-		Value &operator=(const Value &cpy)
-		{
-			if (this != &cpy)
-			{
-				type = cpy.type;
-				if (type == COLOR)
-					value.c = cpy.value.c;
-				if (type == FLOAT)
-					value.f = cpy.value.f;
-				if (type == INT)
-					value.i = cpy.value.i;
-			}
-			return (*this);
-		}
-		bool isSame(const Value &cpy) const
-		{
-			if (type != cpy.type)
-				return (false);
-			if (type == COLOR && value.c != cpy.value.c)
-				return (false);
-			if (type == FLOAT && value.f != cpy.value.f)
-				return (false);
-			if (type == INT && value.i != cpy.value.i)
-				return (false);
-			return (true);
-		}
-
-		ValueType type;
-		UnionValue value;
-	};
-
-	bool operator==(const Value &lhs, const Value &rhs);
-	bool operator!=(const Value &lhs, const Value &rhs);
-
     struct MaterialUniformBuffer
     {
         glm::vec4 Ka; // ambient
@@ -104,23 +41,69 @@ namespace Dwarf
         int illum; // illum
     };
 
+    /// \struct TableTexture
+    /// \brief Where bindless.frag samples a texture: a slot of the texture array, or a layer of a slot of the texture array array
+    struct TableTexture
+    {
+        int32_t texture;
+        /// -1 unless packed, the texture slot is then unused
+        int32_t array;
+        int32_t layer;
+    };
+
+    /// \struct MaterialPbrParameters
+    /// \brief Parameters read from the material libraries but not used by the shaders yet
+    struct MaterialPbrParameters
+    {
+        float roughness;
+        float metallic;
+        float sheen;
+        float clearcoatThickness;
+        float clearcoatRoughness;
+        float anisotropy;
+        float anisotropyRotation;
+    };
+
+    /// \struct MaterialPipeline
+    /// \brief Pipeline compiled on a worker thread, it can only be bound once ready is set
+    struct MaterialPipeline
+    {
+        MaterialPipeline() : ready(false) {}
+
+        vk::Pipeline pipeline;
+        std::atomic<bool> ready;
+    };
+
+    class MaterialTable;
+
 	class Material
 	{
 	public:
         typedef int ID;
-		Material(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::Pipeline &pipeline, const vk::PipelineLayout &pipelineLayout, ID id, const std::string &name);
+		Material(const vk::Device &device, const vk::Queue &graphicsQueue, const MaterialPipeline &pipeline, const vk::Pipeline &fallbackPipeline, const vk::PipelineLayout &pipelineLayout, TextureManager &textureManager, ID id, const std::string &name);
 		virtual ~Material();
         void buildDescriptorSet(const vk::Buffer &buffer, const vk::DeviceSize &uniformBufferOffset, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::DescriptorBufferInfo &lightBufferInfo);
+		/// \brief Same content, whatever the name or identifier
 		bool isSame(const Material &material) const;
+        /// \brief Hash of the parameters and texture names, recomputed after a change
+        uint64_t getHash() const;
         ID getID() const;
         const std::string &getName() const;
+        /// \brief The material pipeline, or the fallback one while it is still compiling
         const vk::Pipeline &getPipeline() const;
+        bool isPipelineReady() const;
         const vk::PipelineLayout &getPipelineLayout() const;
         const vk::DescriptorSet &getDescriptorSet() const;
         const MaterialUniformBuffer &getUniformBuffer() const;
         bool hasDiffuseTexture() const;
-        void setCommandPool(vk::CommandPool *commandPool);
+        /// \brief Indexed by TextureSlot, null for the slots without a texture
+        const std::array<Texture *, TEXTURE_SLOT_COUNT> &getTextures() const;
         void setDescriptorSet(vk::DescriptorSet descriptorSet);
+        /// \brief Bindless mode: the parameters and diffuse texture go to the table entry instead of a descriptor set of their own
+        void setMaterialTable(MaterialTable *materialTable, uint32_t tableIndex);
+        bool isBindless() const;
+        /// \brief Index of the material in the table, pushed with every draw
+        uint32_t getTableIndex() const;
 		void setAmbient(Color value);
 		void setDiffuse(Color value);
 		void setSpecular(Color value);
@@ -152,18 +135,29 @@ namespace Dwarf
 
 	private:
 		void init();
+        void createTexture(TextureSlot slot, const std::string &textureName);
+        /// \brief Invalidate the hash and mirror the parameters to the material table
+        void update();
 
 		const vk::Device &_device;
 		const vk::Queue &_graphicsQueue;
-		const vk::Pipeline &_pipeline;
+		const MaterialPipeline &_pipeline;
+		const vk::Pipeline &_fallbackPipeline;
         const vk::PipelineLayout &_pipelineLayout;
-        vk::CommandPool *_commandPool;
+        TextureManager &_textureManager;
 		vk::DescriptorSet _descriptorSet;
+        MaterialTable *_materialTable;
+        uint32_t _tableIndex;
+        /// Slot of the diffuse texture in the table, texture -1 until it is loaded
+        TableTexture _diffuseTexture;
         const ID _id;
         const std::string _name;
+        /// Mirrored as is by the uniform buffer or the material table entry
         MaterialUniformBuffer _uniformBuffer;
-		std::map<const MaterialType, Value> _values;
-		std::map<const MaterialType, Texture *> _textures;
+        MaterialPbrParameters _pbrParameters;
+        std::array<Texture *, TEXTURE_SLOT_COUNT> _textures;
+        mutable uint64_t _hash;
+        mutable bool _hashValid;
 	};
 
 	bool operator==(const Material &lhs, const Material &rhs);
@@ -3,42 +3,82 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "DescriptorAllocator.h"
 #include "Material.h"
+#include "MaterialTable.h"
+#include "PipelineCache.h"
+#include "PipelineState.h"
+#include "ShaderLibrary.h"
+#include "TextureManager.h"
+#include "ThreadPool.h"
 
 namespace Dwarf
 {
 	class MaterialManager
 	{
 	public:
-		MaterialManager(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::RenderPass &renderPass, const vk::Extent2D &swapChainExtent);
+		MaterialManager(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::RenderPass &renderPass, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator, TextureManager &textureManager, SamplerCache &samplerCache, uint32_t compileThreadCount, MaterialTable *materialTable = nullptr);
 		virtual ~MaterialManager();
         bool exist(const Material::ID materialID) const;
         bool exist(const std::string &materialName) const;
 		void addMaterial(Material *material);
         Material *getMaterial(const std::string &materialName) const;
-        Material *createMaterial(const std::string &materialName, bool diffuseTexture);
-        void createDescriptorPool();
+        Material *createMaterial(const std::string &materialName, bool diffuseTexture, bool alphaTest = false);
+        /// \brief Once its parameters and textures are set, replace the material by an existing one with the same content
+        ///
+        /// The duplicate is destroyed and its name resolves to the interned material from then on.
+        Material *internMaterial(Material *material);
+        void logStatistics() const;
+        /// \brief Recompile every pipeline concurrently and wait for them
         void recreatePipelines();
+        /// \brief Block until the queued pipelines are compiled, needed before the render pass changes
+        void waitPipelines();
 
 	private:
         void createDescriptorSetLayout();
         void createPipelineLayout();
-        void createMaterialPipeline(const Material::ID &materialID, bool diffuseTexture);
+        PipelineState getPipelineState(bool diffuseTexture, bool alphaTest) const;
+        /// \brief Pipeline shared by every material with this state, queued for compilation on first use
+        const MaterialPipeline &getPipeline(const PipelineState &state);
+        void queuePipeline(const PipelineState &state, MaterialPipeline &pipeline);
+        void createPipeline(const PipelineState &state, MaterialPipeline &pipeline);
 		bool isSame(const Material::ID &leftMaterialID, Material *rightMaterial) const;
+        void destroyMaterial(Material *material);
 
         const vk::Device &_device;
         const vk::Queue &_graphicsQueue;
         const vk::RenderPass &_renderPass;
-        const vk::Extent2D &_swapChainExtent;
+        PipelineCache &_pipelineCache;
+        ShaderLibrary &_shaderLibrary;
+        /// Every material gets its set when created, unless it is bindless
+        DescriptorAllocator &_descriptorAllocator;
+        /// Handed to the materials, which acquire their textures from it
+        TextureManager &_textureManager;
+        /// Source of the immutable sampler of the texture binding
+        SamplerCache &_samplerCache;
+        /// Bindless mode when set, owned by the renderer
+        MaterialTable *_materialTable;
         vk::DescriptorSetLayout _descriptorSetLayout;
         vk::PipelineLayout _pipelineLayout;
-        vk::DescriptorPool _descriptorPool;
         Material::ID _lastID;
         std::map<const std::string, Material::ID> _materialsNames;
         std::map<const Material::ID, Material *> _materials;
-        std::map<const Material::ID, vk::Pipeline> _pipelines;
-        std::map<const Material::ID, vk::DescriptorSet> _descriptorSets;
+        /// Content hash of the interned materials
+        std::unordered_map<uint64_t, Material::ID> _materialsHashes;
+        /// Already handed to submeshes, never destroyed as a duplicate
+        std::unordered_set<Material::ID> _internedMaterials;
+        uint32_t _duplicateCount;
+        /// Node based, materials keep references to the pipelines across insertions and recreations
+        std::unordered_map<PipelineState, MaterialPipeline> _pipelines;
+        /// Untextured pipeline, compiled up front and bound by the materials whose pipeline is not ready
+        const vk::Pipeline *_fallbackPipeline;
+        /// Own workers, so that recording the frames never waits on a compilation
+        ThreadPool _compilePool;
+        uint32_t _compileThreadCount;
+        uint32_t _nextCompileThread;
 	};
 }
 
@@ -0,0 +1,90 @@
+#ifndef DWARF_MATERIALTABLE_H_
+#define DWARF_MATERIALTABLE_H_
+#pragma once
+
+#include <unordered_map>
+
+#include "Material.h"
+
+#define DWARF_BINDLESS_MAX_MATERIALS 4096
+// Clamped to the device's per stage sampler limits
+#define DWARF_BINDLESS_MAX_TEXTURES 1024
+// Taken out of the texture slots, both arrays count against the same limits
+#define DWARF_BINDLESS_MAX_TEXTURE_ARRAYS 64
+
+namespace Dwarf
+{
+    /// \struct MaterialEntry
+    /// \brief One element of the material storage buffer, std430 layout of bindless.frag
+    struct MaterialEntry
+    {
+        MaterialUniformBuffer parameters;
+        TableTexture diffuseTexture;
+        int32_t padding;
+    };
+
+    /// \class MaterialTable
+    /// \brief Parameters of every material in one storage buffer and every texture in one descriptor array
+    ///
+    /// The whole table is a single descriptor set bound once per command buffer, the materials are
+    /// addressed by an index pushed with the draw. With VK_EXT_descriptor_indexing the texture array is
+    /// partially bound and can be written while in use, otherwise every slot not written yet holds a
+    /// 1x1 white texture, which is also slot 0 and what untextured materials sample.
+    /// Textures packed by the texture manager are sampled from a second array, of 2D array images.
+    class MaterialTable
+    {
+    public:
+        MaterialTable(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::PhysicalDeviceLimits &limits, SamplerCache &samplerCache, bool descriptorIndexing);
+        virtual ~MaterialTable();
+        /// \brief Reserve the entry of a new material, its index for the shaders
+        uint32_t addMaterial();
+        /// \brief Give the entry back for a later material
+        void removeMaterial(uint32_t index);
+        /// \brief Slot of the texture, created and written on its first addition, slot 0 (white) when the arrays are full
+        ///
+        /// A packed texture takes the slot of its array instead, its layer is sampled.
+        TableTexture addTexture(Texture &texture, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        void setMaterial(uint32_t index, const MaterialUniformBuffer &parameters, const TableTexture &diffuseTexture);
+        void setLight(const vk::DescriptorBufferInfo &lightBufferInfo);
+        const vk::DescriptorSetLayout &getDescriptorSetLayout() const;
+        const vk::DescriptorSet &getDescriptorSet() const;
+        /// \brief Size of the texture array, a specialisation constant of bindless.frag
+        uint32_t getTextureCapacity() const;
+        /// \brief Size of the texture array array, a specialisation constant of bindless.frag
+        uint32_t getTextureArrayCapacity() const;
+
+    private:
+        void createWhiteTexture(const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        void createDescriptorSet();
+        void createBuffer(const vk::PhysicalDeviceMemoryProperties &memProperties);
+
+        const vk::Device &_device;
+        SamplerCache &_samplerCache;
+        const bool _descriptorIndexing;
+        uint32_t _textureCapacity;
+        uint32_t _arrayCapacity;
+        vk::DescriptorSetLayout _descriptorSetLayout;
+        vk::DescriptorPool _descriptorPool;
+        vk::DescriptorSet _descriptorSet;
+        vk::Buffer _buffer;
+        vk::DeviceMemory _bufferMemory;
+        MaterialEntry *_entries;
+        vk::Image _whiteImage;
+        vk::DeviceMemory _whiteImageMemory;
+        vk::ImageView _whiteImageView;
+        /// The white texture as a single layer array, what the unused array slots hold
+        vk::ImageView _whiteArrayView;
+        /// Owned by the sampler cache
+        vk::Sampler _whiteSampler;
+        vk::DescriptorBufferInfo _lightBufferInfo;
+        uint32_t _materialCount;
+        std::vector<uint32_t> _freeMaterials;
+        uint32_t _textureCount;
+        /// Slot of every texture already in the array, materials sharing a texture or its content share its slot
+        std::unordered_map<const Texture *, int32_t> _textureSlots;
+        uint32_t _arrayCount;
+        std::unordered_map<const TextureArray *, int32_t> _arraySlots;
+    };
+}
+
+#endif // DWARF_MATERIALTABLE_H_
@@ -25,16 +25,21 @@ namespace Dwarf
 	{
 	public:
         Mesh(const vk::Device &device, Dwarf::MaterialManager &materialManager, const std::string &meshFilename, const vk::DescriptorBufferInfo &lightBufferInfo);
+        Mesh(const vk::Device &device, const vk::DescriptorBufferInfo &lightBufferInfo);
 		virtual ~Mesh();
 
 		void loadFromFile(Dwarf::MaterialManager &materialManager, const std::string &filename);
+        void addSubmesh(Material *material, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
         std::vector<IBuildable *> getBuildables();
         std::vector<Submesh> &getSubmeshes();
+        void setStatic(bool isStatic);
+        bool isStatic() const;
 
 	private:
 		const vk::Device &_device;
         const vk::DescriptorBufferInfo &_lightBufferInfo;
         std::vector<Submesh> _submeshes;
+        bool _static;
 	};
 
     struct TmpSubmesh
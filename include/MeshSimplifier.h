@@ -0,0 +1,55 @@
+#ifndef DWARF_MESHSIMPLIFIER_H_
+#define DWARF_MESHSIMPLIFIER_H_
+#pragma once
+
+#include <vector>
+
+#include "MeshData.h"
+
+namespace Dwarf
+{
+    /// \class MeshSimplifier
+    /// \brief Quadric edge collapse simplification producing indices into the same vertices
+    ///
+    /// Vertices are only collapsed onto existing ones, so every level of detail shares the
+    /// vertex buffer. Vertices on a border or on an attribute seam (several vertices at the same
+    /// position) are never moved, which keeps the silhouette and the texture mapping intact.
+    class MeshSimplifier
+    {
+    public:
+        MeshSimplifier(const std::vector<Vertex> &vertices);
+        virtual ~MeshSimplifier();
+        /// \brief Simplify a triangle list down to about targetIndexCount indices
+        /// \return The geometric error of the result, in object space units
+        float simplify(const std::vector<uint32_t> &indices, size_t targetIndexCount, std::vector<uint32_t> &result) const;
+
+    private:
+        struct Quadric
+        {
+            Quadric();
+            Quadric(const glm::vec3 &normal, float distance, float weight);
+            Quadric &operator+=(const Quadric &rhs);
+            float evaluate(const glm::vec3 &position) const;
+
+            double a00, a01, a02, a11, a12, a22;
+            double b0, b1, b2;
+            double c;
+            double weight;
+        };
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            float error;
+        };
+
+        bool flips(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &adjacencyOffsets, const std::vector<uint32_t> &adjacency, uint32_t from, uint32_t to) const;
+
+        const std::vector<Vertex> &_vertices;
+        std::vector<uint32_t> _positionRemap;
+        std::vector<bool> _seams;
+    };
+}
+
+#endif // DWARF_MESHSIMPLIFIER_H_
@@ -0,0 +1,45 @@
+#ifndef DWARF_MESHLETBUILDER_H_
+#define DWARF_MESHLETBUILDER_H_
+#pragma once
+
+#include <vector>
+
+#include "MeshData.h"
+
+#define DWARF_MESHLET_MAX_VERTICES 64
+#define DWARF_MESHLET_MAX_TRIANGLES 124
+
+namespace Dwarf
+{
+    /// \struct Meshlet
+    /// \brief Contiguous range of triangles with its bounds and normal cone, in object space
+    ///
+    /// The cone holds the average normal and the cutoff of the cluster: the whole meshlet faces
+    /// away from a camera when dot(center - camera, axis) >= cutoff * length(center - camera) + radius.
+    /// A cutoff of 1 disables the test.
+    struct Meshlet
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        glm::vec4 boundingSphere;
+        glm::vec4 cone;
+    };
+
+    /// \class MeshletBuilder
+    /// \brief Partitions a triangle list in meshlets of neighbouring triangles
+    class MeshletBuilder
+    {
+    public:
+        MeshletBuilder(const std::vector<Vertex> &vertices);
+        virtual ~MeshletBuilder();
+        /// \brief Reorder the triangles so that every meshlet is a contiguous range of indices
+        void build(std::vector<uint32_t> &indices, std::vector<Meshlet> &meshlets) const;
+
+    private:
+        void computeBounds(const std::vector<uint32_t> &indices, Meshlet &meshlet) const;
+
+        const std::vector<Vertex> &_vertices;
+    };
+}
+
+#endif // DWARF_MESHLETBUILDER_H_
@@ -0,0 +1,57 @@
+#ifndef DWARF_PIPELINECACHE_H_
+#define DWARF_PIPELINECACHE_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Tools.h"
+
+#define DWARF_PIPELINECACHE_MAGIC 0x43505744 // "DWPC"
+
+namespace Dwarf
+{
+    /// \class PipelineCache
+    /// \brief vk::PipelineCache persisted next to the executable, one file per device and driver version
+    ///
+    /// Every pipeline of the renderer is created through it. A file whose header does not match the
+    /// current device (vendor, device, pipeline cache UUID) or driver version is discarded.
+    class PipelineCache
+    {
+    public:
+        PipelineCache(const vk::Device &device, const vk::PhysicalDeviceProperties &properties);
+        virtual ~PipelineCache();
+        vk::Pipeline createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo &pipelineInfo);
+        vk::Pipeline createComputePipeline(const vk::ComputePipelineCreateInfo &pipelineInfo);
+        void save() const;
+        void logStatistics() const;
+        const vk::PipelineCache &getCache() const;
+
+    private:
+        /// \brief Prepended to the driver's data, which does not hold the driver version
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t driverVersion;
+            uint64_t dataSize;
+        };
+
+        std::vector<char> load() const;
+        bool isValid(const std::vector<char> &data) const;
+        /// \brief Vulkan 1.0 does not report hits, creations are only counted and timed, compare warm and cold runs
+        void record(const std::chrono::high_resolution_clock::time_point &start);
+
+        const vk::Device &_device;
+        const vk::PhysicalDeviceProperties _properties;
+        std::string _path;
+        vk::PipelineCache _cache;
+        /// Started from a file, the creations should then mostly be hits
+        bool _warm;
+        std::atomic<uint32_t> _creations;
+        std::atomic<uint64_t> _creationTime;
+    };
+}
+
+#endif // DWARF_PIPELINECACHE_H_
@@ -0,0 +1,77 @@
+#ifndef DWARF_PIPELINESTATE_H_
+#define DWARF_PIPELINESTATE_H_
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "Tools.h"
+#include "MeshData.h"
+
+namespace Dwarf
+{
+    /// \struct PipelineState
+    /// \brief Everything a material pipeline is built from, materials sharing it share the pipeline
+    struct PipelineState
+    {
+        PipelineState()
+            : binding(Vertex::getBindingDescription()), attributes(Vertex::getAttributeDescriptions()), topology(vk::PrimitiveTopology::eTriangleList),
+            cullMode(vk::CullModeFlagBits::eFront), frontFace(vk::FrontFace::eCounterClockwise), depthTest(VK_TRUE), depthWrite(VK_TRUE), depthCompare(vk::CompareOp::eLess), blend(VK_FALSE),
+            textured(VK_FALSE), alphaTest(VK_FALSE)
+        {}
+
+        bool operator==(const PipelineState &rhs) const
+        {
+            return (vertexShader == rhs.vertexShader && fragmentShader == rhs.fragmentShader && binding == rhs.binding && attributes == rhs.attributes
+                && topology == rhs.topology && cullMode == rhs.cullMode && frontFace == rhs.frontFace
+                && depthTest == rhs.depthTest && depthWrite == rhs.depthWrite && depthCompare == rhs.depthCompare && blend == rhs.blend
+                && textured == rhs.textured && alphaTest == rhs.alphaTest);
+        }
+
+        std::string vertexShader;
+        std::string fragmentShader;
+        vk::VertexInputBindingDescription binding;
+        std::array<vk::VertexInputAttributeDescription, 3> attributes;
+        vk::PrimitiveTopology topology;
+        vk::CullModeFlags cullMode;
+        vk::FrontFace frontFace;
+        vk::Bool32 depthTest;
+        vk::Bool32 depthWrite;
+        vk::CompareOp depthCompare;
+        vk::Bool32 blend;
+        /// Specialisation constants 0 and 1 of material.frag
+        vk::Bool32 textured;
+        vk::Bool32 alphaTest;
+    };
+}
+
+namespace std
+{
+    template<> struct hash<Dwarf::PipelineState>
+    {
+        size_t operator()(const Dwarf::PipelineState &state) const
+        {
+            size_t seed = hash<string>()(state.vertexShader);
+            Dwarf::Tools::hashCombine(seed, hash<string>()(state.fragmentShader));
+            Dwarf::Tools::hashCombine(seed, state.binding.stride);
+            for (const auto &attribute : state.attributes)
+            {
+                Dwarf::Tools::hashCombine(seed, attribute.location);
+                Dwarf::Tools::hashCombine(seed, static_cast<size_t>(attribute.format));
+                Dwarf::Tools::hashCombine(seed, attribute.offset);
+            }
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(state.topology));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(static_cast<VkCullModeFlags>(state.cullMode)));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(state.frontFace));
+            Dwarf::Tools::hashCombine(seed, state.depthTest);
+            Dwarf::Tools::hashCombine(seed, state.depthWrite);
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(state.depthCompare));
+            Dwarf::Tools::hashCombine(seed, state.blend);
+            Dwarf::Tools::hashCombine(seed, state.textured);
+            Dwarf::Tools::hashCombine(seed, state.alphaTest);
+            return (seed);
+        }
+    };
+}
+
+#endif // DWARF_PIPELINESTATE_H_
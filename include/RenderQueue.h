@@ -0,0 +1,64 @@
+#ifndef DWARF_RENDERQUEUE_H_
+#define DWARF_RENDERQUEUE_H_
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "IBuildable.h"
+#include "ThreadPool.h"
+
+// Below this many draws the radix sort runs on the calling thread
+#define DWARF_RENDERQUEUE_PARALLEL_THRESHOLD 4096
+#define DWARF_RENDERQUEUE_RADIX_BITS 8
+
+namespace Dwarf
+{
+    enum DrawPass
+    {
+        DRAW_OPAQUE,
+        DRAW_TRANSPARENT
+    };
+
+    struct RenderItem
+    {
+        uint64_t key;
+        IBuildable *buildable;
+    };
+
+    /// \class RenderQueue
+    /// \brief Visible draws of a frame sorted by a 64 bits key
+    ///
+    /// From the most significant bits: pass (4 bits), pipeline (12 bits), material (16 bits) and
+    /// quantised view depth (32 bits), opaque draws going front to back within a state. Transparent
+    /// draws put the depth (its 28 most significant bits) right below the pass and go back to front
+    /// across every state.
+    class RenderQueue
+    {
+    public:
+        RenderQueue(ThreadPool &threadPool, const uint32_t &numThreads);
+        virtual ~RenderQueue();
+        void clear();
+        void push(uint64_t key, IBuildable *buildable);
+        /// \brief Stable least significant digit radix sort, histograms and scatters are split across the threads
+        void sort();
+        /// \brief Compact identifier of a pipeline, stable for the lifetime of the queue
+        uint32_t getPipelineID(const vk::Pipeline &pipeline);
+        const std::vector<RenderItem> &getItems() const;
+        static uint64_t makeKey(DrawPass pass, uint32_t pipelineID, uint32_t materialID, float depth);
+
+    private:
+        void countDigits(size_t threadIndex, size_t threadCount, uint32_t shift);
+        void scatterDigits(size_t threadIndex, size_t threadCount, uint32_t shift);
+
+        ThreadPool &_threadPool;
+        const uint32_t &_numThreads;
+        std::vector<RenderItem> _items;
+        std::vector<RenderItem> _sortBuffer;
+        std::vector<std::vector<size_t>> _histograms;
+        std::unordered_map<VkPipeline, uint32_t> _pipelineIDs;
+    };
+}
+
+#endif // DWARF_RENDERQUEUE_H_
@@ -21,6 +21,14 @@
 #include "CommandBuffersBuilder.h"
 #include "LightManager.h"
 #include "DeviceAllocationManager.h"
+#include "CullingManager.h"
+#include "StaticBatcher.h"
+#include "PipelineCache.h"
+#include "SamplerCache.h"
+#include "ShaderLibrary.h"
+#include "DescriptorAllocator.h"
+#include "TextureManager.h"
+#include "TextureStreamer.h"
 
 const std::vector<const char *> gValidationLayers = {
 	"VK_LAYER_LUNARG_standard_validation"
@@ -36,6 +44,30 @@ const bool gEnableValidationLayers = true;
 const bool gEnableValidationLayers = true;
 #endif
 
+#ifdef DWARF_VALIDATE_CULLING
+const bool gValidateCulling = true;
+#else
+const bool gValidateCulling = false;
+#endif
+
+#ifdef DWARF_BINDLESS
+const bool gBindless = true;
+#else
+const bool gBindless = false;
+#endif
+
+#ifdef DWARF_IMMUTABLE_SAMPLERS
+const bool gImmutableSamplers = true;
+#else
+const bool gImmutableSamplers = false;
+#endif
+
+#ifdef DWARF_TEXTURE_STREAMING
+const bool gTextureStreaming = true;
+#else
+const bool gTextureStreaming = false;
+#endif
+
 /// \namespace Dwarf
 /// \brief Entire engine's namespace
 ///
@@ -116,6 +148,7 @@ namespace Dwarf
         bool isDeviceSuitable(const vk::PhysicalDevice &device) const;
 		QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &device) const;
         bool checkDeviceExtensionSupport(const vk::PhysicalDevice &device) const;
+        bool isDeviceExtensionAvailable(const char *extensionName) const;
         SwapChainSupportDetails querySwapChainSupport(const vk::PhysicalDevice &device) const;
 		vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &availableFormats);
 		vk::PresentModeKHR chooseSwapPresentFormat(const std::vector<vk::PresentModeKHR> &availablePresentModes);
@@ -126,6 +159,7 @@ namespace Dwarf
 		
 		void createBuffer(const vk::DeviceSize &size, const vk::BufferUsageFlags &usage, const vk::MemoryPropertyFlags &properties, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory) const;
 		void copyBuffer(const vk::Buffer &srcBuffer, const vk::Buffer &dstBuffer, const vk::DeviceSize &size) const;
+		/// \brief Apply the pending resize, the previous frame must be complete
 		void recreateSwapChain();
 
 		static void onWindowResized(GLFWwindow *window, int width, int height);
@@ -158,6 +192,7 @@ namespace Dwarf
 		std::vector<vk::Framebuffer> _swapChainFramebuffers;
 
 		vk::RenderPass _renderPass;
+		vk::RenderPass _renderPassLoad;
 
 		vk::CommandPool _commandPool;
 
@@ -187,6 +222,25 @@ namespace Dwarf
             bool up = false;
         } _movance;
         DeviceAllocationManager *_deviceAllocator;
+        CullingManager *_cullingManager;
+        PipelineCache *_pipelineCache;
+        ShaderLibrary *_shaderLibrary;
+        DescriptorAllocator *_descriptorAllocator;
+        SamplerCache *_samplerCache;
+        /// Texture uploads of the loading, submitted together once the buildables are created
+        TextureUploader *_textureUploader;
+        TextureManager *_textureManager;
+        /// Null unless streaming textures
+        TextureStreamer *_textureStreamer;
+        /// Bindless materials, null when disabled or unsupported by the device
+        MaterialTable *_materialTable;
+        bool _bindless;
+        bool _descriptorIndexing;
+        /// Window size of the last resize events, applied once at the start of the next frame
+        vk::Extent2D _pendingExtent;
+        bool _resizePending;
+        /// Replaced swap chain, destroyed once a frame has been presented with its successor
+        vk::SwapchainKHR _retiredSwapChain;
 	};
 }
 
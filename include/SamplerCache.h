@@ -0,0 +1,65 @@
+#ifndef DWARF_SAMPLERCACHE_H_
+#define DWARF_SAMPLERCACHE_H_
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+
+#include "Tools.h"
+
+namespace std
+{
+    template<> struct hash<vk::SamplerCreateInfo>
+    {
+        size_t operator()(const vk::SamplerCreateInfo &samplerInfo) const
+        {
+            size_t seed = static_cast<size_t>(static_cast<VkSamplerCreateFlags>(samplerInfo.flags));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.magFilter));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.minFilter));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.mipmapMode));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.addressModeU));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.addressModeV));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.addressModeW));
+            Dwarf::Tools::hashCombine(seed, hash<float>()(samplerInfo.mipLodBias));
+            Dwarf::Tools::hashCombine(seed, samplerInfo.anisotropyEnable);
+            Dwarf::Tools::hashCombine(seed, hash<float>()(samplerInfo.maxAnisotropy));
+            Dwarf::Tools::hashCombine(seed, samplerInfo.compareEnable);
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.compareOp));
+            Dwarf::Tools::hashCombine(seed, hash<float>()(samplerInfo.minLod));
+            Dwarf::Tools::hashCombine(seed, hash<float>()(samplerInfo.maxLod));
+            Dwarf::Tools::hashCombine(seed, static_cast<size_t>(samplerInfo.borderColor));
+            Dwarf::Tools::hashCombine(seed, samplerInfo.unnormalizedCoordinates);
+            return (seed);
+        }
+    };
+}
+
+namespace Dwarf
+{
+    /// \class SamplerCache
+    /// \brief One sampler per description, shared by every user and destroyed with the cache
+    ///
+    /// Samplers are immutable objects, the descriptions without pNext are the keys. The cached samplers
+    /// can also be baked into descriptor set layouts as immutable samplers.
+    class SamplerCache
+    {
+    public:
+        SamplerCache(const vk::Device &device, bool immutableSamplers);
+        virtual ~SamplerCache();
+        /// \brief Thread safe, the reference stays valid as long as the cache
+        const vk::Sampler &getSampler(const vk::SamplerCreateInfo &samplerInfo);
+        /// \brief Sampler to bake into a layout binding, null when immutable samplers are disabled
+        const vk::Sampler *getImmutableSampler(const vk::SamplerCreateInfo &samplerInfo);
+        void logStatistics() const;
+
+    private:
+        const vk::Device &_device;
+        const bool _immutableSamplers;
+        std::mutex _mutex;
+        /// Node based, references to the samplers survive insertions
+        std::unordered_map<vk::SamplerCreateInfo, vk::Sampler> _samplers;
+        uint32_t _requestCount;
+    };
+}
+
+#endif // DWARF_SAMPLERCACHE_H_
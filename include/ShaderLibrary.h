@@ -0,0 +1,33 @@
+#ifndef DWARF_SHADERLIBRARY_H_
+#define DWARF_SHADERLIBRARY_H_
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "Tools.h"
+
+namespace Dwarf
+{
+    /// \class ShaderLibrary
+    /// \brief Loads every SPIR-V file once and keeps its shader module alive until destruction
+    ///
+    /// Variants of a shader are specialisation constants of the same module, so a module is shared
+    /// by every pipeline using the file whatever their constants.
+    class ShaderLibrary
+    {
+    public:
+        ShaderLibrary(const vk::Device &device);
+        virtual ~ShaderLibrary();
+        /// \brief Thread safe, the returned reference stays valid for the lifetime of the library
+        const vk::ShaderModule &getModule(const std::string &path);
+
+    private:
+        const vk::Device &_device;
+        std::mutex _mutex;
+        std::map<const std::string, vk::ShaderModule> _modules;
+    };
+}
+
+#endif // DWARF_SHADERLIBRARY_H_
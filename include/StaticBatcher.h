@@ -0,0 +1,52 @@
+#ifndef DWARF_STATICBATCHER_H_
+#define DWARF_STATICBATCHER_H_
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+
+namespace Dwarf
+{
+    /// \class StaticBatcher
+    /// \brief Merges the submeshes of static meshes sharing a material into world space batches
+    ///
+    /// Triangles are bucketed in cubic cells of chunkSize world units so that every batch stays
+    /// spatially compact and can still be culled.
+    class StaticBatcher
+    {
+    public:
+        StaticBatcher(const vk::Device &device, const vk::DescriptorBufferInfo &lightBufferInfo, float chunkSize = 64.0f);
+        virtual ~StaticBatcher();
+        /// \brief Replace the static meshes of the list by batch meshes appended at its end
+        ///
+        /// Must run before the device allocation. The static meshes are deleted, the batches are
+        /// owned by the list like any other mesh.
+        void batch(std::vector<Mesh *> &meshes) const;
+
+    private:
+        typedef std::tuple<Material *, int, int, int> BatchKey;
+
+        struct Batch
+        {
+            Batch() : source(0) {}
+
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices;
+            /// Vertices of the source submesh (numbered from 1) already copied in the batch
+            size_t source;
+            std::unordered_map<uint32_t, uint32_t> remap;
+        };
+
+        BatchKey getKey(Material *material, const glm::vec3 &position) const;
+
+        const vk::Device &_device;
+        const vk::DescriptorBufferInfo &_lightBufferInfo;
+        const float _chunkSize;
+    };
+}
+
+#endif // DWARF_STATICBATCHER_H_
@@ -6,9 +6,24 @@
 #include "IBuildable.h"
 #include "Material.h"
 #include "MeshData.h"
+#include "MeshletBuilder.h"
+#include "RenderQueue.h"
+
+// The culling compute shader packs the levels of detail of a submesh in vec4s
+#define DWARF_MAX_LODS 4
+#define DWARF_MIN_LOD_TRIANGLES 32
 
 namespace Dwarf
 {
+    /// \struct SubmeshLod
+    /// \brief Range of the concatenated index buffer drawn for one level of detail
+    struct SubmeshLod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+    };
+
     class Submesh : public IBuildable
     {
     public:
@@ -16,19 +31,32 @@ namespace Dwarf
         virtual ~Submesh();
         void cleanup(const vk::Device &device) const;
         virtual void createBuffers(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::PhysicalDeviceMemoryProperties &memProperties);
-        virtual void buildCommandBuffer(const vk::CommandBufferInheritanceInfo &inheritanceInfo, const glm::mat4 &mvp, const vk::Extent2D &extent) const;
+        virtual void enqueue(RenderQueue &renderQueue, const glm::mat4 &mvp);
+        virtual void recordDraw(const vk::CommandBuffer &commandBuffer, const glm::mat4 &mvp, DrawState &state) const;
         virtual void setCommandPool(vk::CommandPool *commandPool);
-        virtual void setCommandBuffer(vk::CommandBuffer commandBuffer);
         void setVertices(const std::vector<Vertex> &vertices);
         void setIndices(const std::vector<uint32_t> &indices);
+        /// \brief Split the finest level of detail in meshlets, must be called before generateLods
+        void buildMeshlets();
+        /// \brief Append simplified index buffers sharing the vertices, each about half of the previous one
+        void generateLods();
         size_t getVerticesCount() const;
         const std::vector<Vertex> &getVertices() const;
         size_t getIndicesCount() const;
         const std::vector<uint32_t> &getIndices() const;
+        const std::vector<SubmeshLod> &getLods() const;
+        const std::vector<Meshlet> &getMeshlets() const;
         void setBuffer(const vk::Buffer &buffer);
         void setVertexBufferOffset(const vk::DeviceSize &vertexBufferOffset);
         void setIndexBufferOffset(const vk::DeviceSize &indexBufferOffset);
-        virtual vk::CommandBuffer getCommandBuffer() const;
+        void setDrawCommandBuffer(const vk::Buffer &drawCommandBuffer, const vk::DeviceSize &drawCommandOffset);
+        /// \brief Second indirect draw, reading the indices of the visible meshlets compacted by the culling
+        void setMeshletDraw(const vk::Buffer &meshletIndexBuffer, const vk::DeviceSize &meshletIndexOffset, const vk::DeviceSize &drawCommandOffset);
+        const vk::Buffer &getBuffer() const;
+        const vk::DeviceSize &getIndexBufferOffset() const;
+        const glm::vec4 &getBoundingSphere() const;
+        const glm::mat4 &getTransform() const;
+        Material *getMaterial() const;
 
     private:
         const vk::DescriptorBufferInfo &_lightBufferInfo;
@@ -37,13 +65,20 @@ namespace Dwarf
         vk::CommandPool *_commandPool;
         std::vector<Vertex> _vertices;
         std::vector<uint32_t> _indices;
+        std::vector<SubmeshLod> _lods;
+        std::vector<Meshlet> _meshlets;
         vk::DeviceMemory _buffersMemory;
         vk::Buffer _buffer;
         vk::Buffer _uniformBuffer;
         vk::DeviceSize _vertexBufferOffset;
         vk::DeviceSize _indexBufferOffset;
         vk::DeviceSize _uniformBufferOffset;
-        vk::CommandBuffer _commandBuffer;
+        vk::Buffer _drawCommandBuffer;
+        vk::DeviceSize _drawCommandOffset;
+        vk::Buffer _meshletIndexBuffer;
+        vk::DeviceSize _meshletIndexOffset;
+        vk::DeviceSize _meshletDrawCommandOffset;
+        glm::vec4 _boundingSphere;
     };
 }
 
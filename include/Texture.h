@@ -4,31 +4,114 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include "SamplerCache.h"
+#include "TextureArray.h"
+#include "TextureFile.h"
+#include "TextureUploader.h"
 #include "Tools.h"
 
+// Streamed textures start with the levels no larger than this, the finer ones are streamed in on demand
+#define DWARF_STREAMING_BASE_SIZE 64
+
 namespace Dwarf
 {
+	/// \struct TextureDescriptor
+	/// \brief Descriptor written with the texture, written again whenever its image changes
+	struct TextureDescriptor
+	{
+		vk::DescriptorSet descriptorSet;
+		uint32_t binding;
+		uint32_t arrayElement;
+	};
+
 	class Texture
 	{
 	public:
-		Texture(const vk::Device &device, vk::CommandPool *commandPool, const vk::Queue &graphicsQueue, const std::string textureName, vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+		Texture(const vk::Device &device, TextureUploader &textureUploader, SamplerCache &samplerCache, const std::string textureName, vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
 		virtual ~Texture();
 
+		/// \brief Read, cook or decode the file on the CPU, thread safe as long as each texture has a single caller
+		void load();
+		/// \brief The image is recorded to the uploader, it can be sampled once the uploader is flushed
+		///
+		/// Loads the file first unless load was already called, later calls return the same image.
 		vk::DescriptorImageInfo &createTexture(const vk::PhysicalDeviceMemoryProperties &memProperties);
-        void setCommandPool(vk::CommandPool *commandPool);
+        const std::string &getName() const;
+        /// \brief Hash of the loaded format, size and data, 0 before load
+        uint64_t getContentHash() const;
+        /// \brief Turn the texture into an alias, its image is the one of the source
+        void setSource(Texture *source);
+        Texture *getSource() const;
+        /// \brief Decoded or cooked data, empty once uploaded unless streaming
+        const TextureFile &getFile() const;
+        /// \brief Box filter the missing mips on the CPU, for the images whose mips cannot be blitted
+        void generateMipmaps();
+        /// \brief Packed as a layer of an array, the texture then has no image nor CPU copy of its own
+        void setArray(TextureArray *textureArray, uint32_t layer);
+        /// \brief Array holding the texture, null unless packed
+        TextureArray *getArray() const;
+        uint32_t getLayer() const;
+        /// \brief Register a descriptor referencing the texture, forwarded to the source of an alias
+        void addDescriptor(const vk::DescriptorSet &descriptorSet, uint32_t binding, uint32_t arrayElement);
+        /// \brief Levels of the whole chain, kept on the CPU while streaming, 0 otherwise
+        uint32_t getLevelCount() const;
+        /// \brief Finest level in memory, the image holds it and every coarser one
+        uint32_t getResidentLevel() const;
+        /// \brief Finest level of the resident set a streamed texture falls back to
+        uint32_t getBaseLevel() const;
+        /// \brief Bytes of the levels from firstLevel to the coarsest one
+        vk::DeviceSize getLevelsSize(uint32_t firstLevel) const;
+        /// \brief Width of the finest level of the whole chain
+        uint32_t getFullWidth() const;
+        /// \brief Record the upload of a new image holding the levels from firstLevel, the current one stays in use until commitStream
+        void stream(uint32_t firstLevel, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        /// \brief Once the uploader completed, switch the descriptors to the new image and destroy the previous one
+        void commitStream();
+
+        /// \brief Whether the device samples BC formats, images are then cooked to BC1 or BC3 at their first load
+        static void setBlockCompression(bool blockCompression);
+        /// \brief Keep every level on the CPU and create the images with the base levels only
+        static void setStreaming(bool streaming);
+        /// \brief Description of the sampler shared by every texture, also baked into the layouts as immutable sampler
+        static vk::SamplerCreateInfo getSamplerInfo();
 
 	private:
+		void decodeTexture(const std::string &path, TextureFile &file) const;
+		void cookTexture(const std::string &path, TextureFile &file) const;
+		/// \brief Create the image of the levels from firstLevel and record their upload
+		void uploadLevels(const vk::PhysicalDeviceMemoryProperties &memProperties, uint32_t firstLevel);
+		void destroyImage(vk::Image &image, vk::DeviceMemory &imageMemory, vk::ImageView &imageView) const;
+
+		static bool _blockCompression;
+		static bool _streaming;
+
 		const vk::Device &_device;
-		const vk::Queue &_graphicsQueue;
+		TextureUploader &_textureUploader;
+		SamplerCache &_samplerCache;
 		const std::string _textureName;
 
-        vk::CommandPool *_commandPool;
 		vk::DeviceMemory _textureImageMemory;
+		/// Owned by the sampler cache
 		vk::Sampler _textureSampler;
 		vk::Image _textureImage;
 		vk::ImageLayout _textureImageLayout;
 		vk::ImageView _textureImageView;
 		vk::DescriptorImageInfo _imageInfo;
+		/// Decoded by load, released once uploaded unless streaming
+		TextureFile _file;
+		std::vector<TextureDescriptor> _descriptors;
+		/// Previous image of a stream, destroyed by commitStream
+		vk::Image _retiredImage;
+		vk::DeviceMemory _retiredImageMemory;
+		vk::ImageView _retiredImageView;
+		uint32_t _residentLevel;
+		/// Texture with the same content, this one creates no image when set
+		Texture *_source;
+		/// Owned by the texture manager
+		TextureArray *_array;
+		uint32_t _layer;
+		uint64_t _contentHash;
+		vk::Format _format;
 		uint32_t _width;
 		uint32_t _height;
 		uint32_t _mipLevels;
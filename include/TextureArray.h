@@ -0,0 +1,40 @@
+#ifndef DWARF_TEXTUREARRAY_H_
+#define DWARF_TEXTUREARRAY_H_
+#pragma once
+
+#include <vector>
+
+#include "TextureFile.h"
+#include "TextureUploader.h"
+#include "Tools.h"
+
+namespace Dwarf
+{
+    /// \class TextureArray
+    /// \brief Textures of the same format, size and level count packed as the layers of one 2D array image
+    ///
+    /// Unlike an atlas the layers keep their own wrapping and mips, the materials only add a layer index.
+    class TextureArray
+    {
+    public:
+        TextureArray(const vk::Device &device, TextureUploader &textureUploader, const vk::Sampler &sampler);
+        virtual ~TextureArray();
+        /// \brief Create the image and record the upload of every layer, in the order of the files
+        void create(const std::vector<const TextureFile *> &files, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        const vk::DescriptorImageInfo &getImageInfo() const;
+        uint32_t getLayerCount() const;
+
+    private:
+        const vk::Device &_device;
+        TextureUploader &_textureUploader;
+        /// Owned by the sampler cache
+        const vk::Sampler _sampler;
+        vk::Image _image;
+        vk::DeviceMemory _imageMemory;
+        vk::ImageView _imageView;
+        vk::DescriptorImageInfo _imageInfo;
+        uint32_t _layerCount;
+    };
+}
+
+#endif // DWARF_TEXTUREARRAY_H_
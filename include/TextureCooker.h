@@ -0,0 +1,22 @@
+#ifndef DWARF_TEXTURECOOKER_H_
+#define DWARF_TEXTURECOOKER_H_
+#pragma once
+
+#include "TextureFile.h"
+
+namespace Dwarf
+{
+    /// \namespace TextureCooker
+    /// \brief Offline conversion of decoded images to block compressed textures
+    ///
+    /// Range fit encoders, fast enough to cook at the first load and good enough for diffuse maps.
+    namespace TextureCooker
+    {
+        /// \brief Box filtered mip chain of RGBA8 pixels, in BC1 when fully opaque and in BC3 otherwise
+        void cook(const unsigned char *pixels, uint32_t width, uint32_t height, TextureFile &file);
+        /// \brief Append the box filtered mips of an uncompressed file holding its first level only
+        void generateMipmaps(TextureFile &file);
+    }
+}
+
+#endif // DWARF_TEXTURECOOKER_H_
@@ -0,0 +1,64 @@
+#ifndef DWARF_TEXTUREFILE_H_
+#define DWARF_TEXTUREFILE_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Tools.h"
+
+namespace Dwarf
+{
+    struct TextureLevel
+    {
+        uint32_t width;
+        uint32_t height;
+        size_t offset;
+        size_t size;
+    };
+
+    /// \class TextureFile
+    /// \brief Texture stored ready for upload: a format, its levels and their data back to back
+    ///
+    /// Reads DDS (legacy FourCC and DX10 headers) and KTX2 without supercompression, writes DDS.
+    /// Formats: BC1, BC3, BC5 and BC7, plus R8G8B8A8 in KTX2.
+    class TextureFile
+    {
+    public:
+        TextureFile();
+        virtual ~TextureFile();
+        /// \brief False when the file is missing, unsupported or truncated
+        bool load(const std::string &path);
+        bool saveDds(const std::string &path) const;
+        /// \brief Start an empty file, levels are then appended from the largest one
+        void reset(vk::Format format, uint32_t width, uint32_t height);
+        void addLevel(const std::vector<unsigned char> &data, uint32_t width, uint32_t height);
+        bool isLoaded() const;
+        bool isCompressed() const;
+        vk::Format getFormat() const;
+        uint32_t getWidth() const;
+        uint32_t getHeight() const;
+        const std::vector<TextureLevel> &getLevels() const;
+        const std::vector<unsigned char> &getData() const;
+
+        /// \brief Whether the extension names a container, as opposed to an image to decode
+        static bool isContainer(const std::string &path);
+        /// \brief Bytes of a level, by blocks of 4x4 texels for the compressed formats
+        static size_t getLevelSize(vk::Format format, uint32_t width, uint32_t height);
+        /// \brief Levels from width x height down to 1x1
+        static uint32_t getMipChainLength(uint32_t width, uint32_t height);
+
+    private:
+        bool loadDds(const std::vector<char> &file);
+        bool loadKtx2(const std::vector<char> &file);
+        bool setLevels(const std::vector<char> &file, size_t offset, uint32_t levelCount);
+
+        vk::Format _format;
+        uint32_t _width;
+        uint32_t _height;
+        std::vector<TextureLevel> _levels;
+        std::vector<unsigned char> _data;
+    };
+}
+
+#endif // DWARF_TEXTUREFILE_H_
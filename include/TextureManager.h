@@ -0,0 +1,62 @@
+#ifndef DWARF_TEXTUREMANAGER_H_
+#define DWARF_TEXTUREMANAGER_H_
+#pragma once
+
+#include <map>
+#include <unordered_map>
+
+#include "Texture.h"
+#include "TextureUploader.h"
+#include "ThreadPool.h"
+
+// Textures up to this size are packed in arrays with the ones of the same format, size and level count
+#define DWARF_PACKED_TEXTURE_SIZE 256
+#define DWARF_PACKED_MAX_LAYERS 64
+
+namespace Dwarf
+{
+    /// \class TextureManager
+    /// \brief Owner of every texture, interned by resolved path then by content and reference counted
+    ///
+    /// Not thread safe, textures are acquired and released while loading and destroying materials.
+    class TextureManager
+    {
+    public:
+        TextureManager(const vk::Device &device, TextureUploader &textureUploader, SamplerCache &samplerCache);
+        virtual ~TextureManager();
+        /// \brief The texture of this file, created on the first request, to be released once unused
+        Texture *acquire(const std::string &textureName);
+        /// \brief Destroyed with its last reference, null is ignored
+        void release(Texture *texture);
+        /// \brief Decode every texture on the workers, then turn the ones with the content of another into aliases of it
+        ///
+        /// Workers pull textures from a shared counter, sizes vary too much for a static split.
+        void loadTextures(ThreadPool &threadPool, uint32_t threadCount);
+        /// \brief Pack the small loaded textures sharing a format, a size and a level count as layers of arrays
+        ///
+        /// A texture alone in its group keeps its own image. Packed ones release their data, the arrays hold it.
+        void packTextures(const vk::PhysicalDeviceMemoryProperties &memProperties, uint32_t maxLayers);
+        void logStatistics() const;
+
+    private:
+        /// \brief Same file, same name: separators unified, no "." component nor repeated separator
+        static std::string resolvePath(const std::string &textureName);
+        /// \brief Same format, size and data, the content hash only buckets
+        static bool isSameContent(const Texture &left, const Texture &right);
+
+        const vk::Device &_device;
+        TextureUploader &_textureUploader;
+        SamplerCache &_samplerCache;
+        /// Ordered, the first texture of a content stays its source whatever the hash map order
+        std::map<std::string, Texture *> _texturesPaths;
+        std::unordered_map<Texture *, uint32_t> _references;
+        std::unordered_map<uint64_t, Texture *> _texturesHashes;
+        std::vector<TextureArray *> _arrays;
+        uint32_t _pathHits;
+        uint32_t _contentHits;
+        uint32_t _misses;
+        uint32_t _packedTextures;
+    };
+}
+
+#endif // DWARF_TEXTUREMANAGER_H_
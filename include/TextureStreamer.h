@@ -0,0 +1,78 @@
+#ifndef DWARF_TEXTURESTREAMER_H_
+#define DWARF_TEXTURESTREAMER_H_
+#pragma once
+
+#include <vector>
+
+#include "Tools.h"
+#include "Mesh.h"
+#include "TextureUploader.h"
+
+// Device memory of the streamed textures, the base levels are always resident even above it
+#ifndef DWARF_TEXTURE_BUDGET
+#define DWARF_TEXTURE_BUDGET (256 * 1024 * 1024)
+#endif
+// Bytes staged per frame, bounds the cost of the copies in a single frame
+#ifndef DWARF_STREAMING_FRAME_BYTES
+#define DWARF_STREAMING_FRAME_BYTES (16 * 1024 * 1024)
+#endif
+
+namespace Dwarf
+{
+    /// \class TextureStreamer
+    /// \brief Residency of the levels of the streamed textures, from their footprint on screen
+    ///
+    /// Every frame the finest level each texture needs is estimated from the visible submeshes using it:
+    /// texels per object unit, from the UV density of the submesh, against pixels per object unit at the
+    /// nearest point of its bounding sphere. Textures needing finer levels are streamed in, largest gap
+    /// first, while the budget allows it, the least recently used ones dropping back to their base levels
+    /// to make room. Vulkan 1.0 has no sparse residency: a new image with the resident levels replaces the
+    /// previous one once its asynchronous upload completes.
+    class TextureStreamer
+    {
+    public:
+        TextureStreamer(TextureUploader &textureUploader, const vk::PhysicalDeviceMemoryProperties &memProperties, vk::DeviceSize budget = DWARF_TEXTURE_BUDGET);
+        virtual ~TextureStreamer();
+        /// \brief Register the submeshes and the streamed textures of their materials
+        void addSubmeshes(std::vector<Mesh *> &meshes);
+        /// \brief Commit the completed streams then plan and submit the next ones, between two frames
+        void update(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, float fov, float viewportHeight);
+        void logStatistics() const;
+
+    private:
+        struct StreamedTexture
+        {
+            Texture *texture;
+            uint32_t requiredLevel;
+            uint64_t lastUsed;
+        };
+
+        struct StreamedSubmesh
+        {
+            Submesh *submesh;
+            /// UV units per object unit, square root of the ratio of the UV and object areas
+            float uvDensity;
+            std::vector<uint32_t> textures;
+        };
+
+        void computeRequiredLevels(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, float lodScale);
+        /// \brief Drop least recently used textures to the levels they need until size fits the budget
+        bool evict(vk::DeviceSize size);
+        void stream(StreamedTexture &streamedTexture, uint32_t level);
+
+        TextureUploader &_textureUploader;
+        const vk::PhysicalDeviceMemoryProperties _memProperties;
+        const vk::DeviceSize _budget;
+        std::vector<StreamedTexture> _textures;
+        std::vector<StreamedSubmesh> _submeshes;
+        /// Streamed textures whose new image is still being uploaded
+        std::vector<Texture *> _pending;
+        vk::DeviceSize _residentSize;
+        vk::DeviceSize _frameBytes;
+        uint64_t _frame;
+        uint32_t _streamedIn;
+        uint32_t _evicted;
+    };
+}
+
+#endif // DWARF_TEXTURESTREAMER_H_
@@ -0,0 +1,62 @@
+#ifndef DWARF_TEXTUREUPLOADER_H_
+#define DWARF_TEXTUREUPLOADER_H_
+#pragma once
+
+#include <vector>
+
+#include "Tools.h"
+
+// Initial size of the staging buffer, it grows to fit a single larger upload
+#define DWARF_STAGING_BUFFER_SIZE (32 * 1024 * 1024)
+
+namespace Dwarf
+{
+    /// \class TextureUploader
+    /// \brief Image uploads from a single persistently mapped staging buffer, recorded into one command buffer
+    ///
+    /// Every level and layer of an image is copied by one copyBufferToImage and the uploads of many images
+    /// share a submission. Images are usable once flushed, a full staging buffer flushes by itself.
+    /// A batch can also be submitted without waiting, the staging buffer is reused once it completes.
+    class TextureUploader
+    {
+    public:
+        TextureUploader(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties);
+        virtual ~TextureUploader();
+        /// \brief Stage the data and record its copy, the buffer offsets of the regions are relative to data
+        ///
+        /// The image may be in any layout and ends in shader read only layout. Levels without a region are
+        /// blitted from level 0, which requires an uncompressed format and a single layer.
+        void upload(const vk::Image &image, const void *data, vk::DeviceSize size, std::vector<vk::BufferImageCopy> regions, uint32_t mipLevels, uint32_t layerCount = 1);
+        /// \brief Submit the recorded uploads and wait for them
+        void flush();
+        /// \brief Submit the recorded uploads without waiting, the next upload waits if they are still running
+        void submit();
+        /// \brief Whether the submitted uploads are complete, nothing submitted counts as complete
+        bool poll();
+
+    private:
+        /// \brief Block until the submitted batch completes
+        void wait();
+        void complete();
+        void createStagingBuffer(vk::DeviceSize size);
+        void destroyStagingBuffer();
+
+        const vk::Device &_device;
+        const vk::Queue &_graphicsQueue;
+        const vk::CommandPool &_commandPool;
+        const vk::PhysicalDeviceMemoryProperties _memProperties;
+        vk::Buffer _stagingBuffer;
+        vk::DeviceMemory _stagingBufferMemory;
+        unsigned char *_stagingData;
+        vk::DeviceSize _stagingSize;
+        vk::DeviceSize _stagingOffset;
+        vk::CommandBuffer _commandBuffer;
+        vk::Fence _fence;
+        /// The command buffer is executing, the staging buffer must not be written
+        bool _submitted;
+        uint32_t _pendingCount;
+        uint32_t _batchCount;
+    };
+}
+
+#endif // DWARF_TEXTUREUPLOADER_H_
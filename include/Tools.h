@@ -24,10 +24,15 @@ namespace Dwarf
 		VkResult CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT *pCreateInfo, const VkAllocationCallbacks *pAllocator, VkDebugReportCallbackEXT *pCallback);
 		void DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks *pAllocator);
 		uint32_t getMemoryType(const vk::PhysicalDeviceMemoryProperties &memProperties, uint32_t typeFilter, const vk::MemoryPropertyFlags &properties);
-		void createImage(const vk::Device &device, vk::PhysicalDeviceMemoryProperties memProperties, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory);
+		void createBuffer(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory);
+		void createImage(const vk::Device &device, vk::PhysicalDeviceMemoryProperties memProperties, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
 		void copyImage(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, vk::Image srcImage, vk::Image dstImage, uint32_t width, uint32_t height);
-		void createImageView(const vk::Device &device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, vk::ImageView &imageView);
-		void transitionImageLayout(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+		/// \brief Record the fill of levels 1 and up by successive linear blits from level 0, which must be in transfer destination layout
+		///
+		/// Every level ends in shader read only layout. The format has to support linear blits with optimal tiling.
+		void recordMipmaps(const vk::CommandBuffer &commandBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels);
+		void createImageView(const vk::Device &device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, vk::ImageView &imageView, uint32_t baseMipLevel = 0, uint32_t levelCount = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D, uint32_t layerCount = 1);
+		void transitionImageLayout(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels = 1);
 		vk::CommandBuffer beginSingleTimeCommands(const vk::Device &device, const vk::CommandPool &commandPool);
 		void endSingleTimeCommands(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, const vk::CommandBuffer &commandBuffer);
 		
@@ -48,6 +53,22 @@ namespace Dwarf
 			}
 		}
 
+		/// \brief 64 bits FNV-1a, chain calls through seed to hash several fields
+		inline uint64_t hash64(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL)
+		{
+			const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+			for (size_t i = 0; i < size; ++i)
+				seed = (seed ^ bytes[i]) * 0x100000001b3ULL;
+			return (seed);
+		}
+
+		/// \brief Mix value into seed, for the std::hash specialisations of flat records
+		inline void hashCombine(size_t &seed, size_t value)
+		{
+			seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		}
+
 #define exitOnError(error) exitOnError(error, __FILENAME__, __LINE__)
 #define exitOnResult(result) exitOnResult(result, __FILENAME__, __LINE__)
 
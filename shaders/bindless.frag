@@ -0,0 +1,63 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 inFragColor;
+layout(location = 1) in vec2 inFragTextureCoord;
+layout(location = 2) in vec3 inWorldPos;
+
+// Variants of the material, specialised when the pipeline is built
+layout(constant_id = 0) const bool TEXTURED = false;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+// Size of the texture array of the material table
+layout(constant_id = 2) const int TEXTURE_COUNT = 1;
+// Size of the array of the packed textures
+layout(constant_id = 3) const int TEXTURE_ARRAY_COUNT = 1;
+
+layout(push_constant) uniform PushConstants
+{
+    layout(offset = 128) uint materialIndex;
+} pushConstants;
+
+struct Material
+{
+    vec4 Ka; // ambient
+    vec4 Kd; // diffuse
+    vec4 Ks; // specular
+    vec4 Tf; // transmittance
+    vec4 Ke; // emission
+    float Ns; // shininess
+    float Ni; // ior
+    float d; // dissolve
+    int illum; // illum
+    int diffuseTexture;
+    int diffuseArray; // -1 unless packed in a texture array
+    int diffuseLayer;
+};
+
+layout(std430, binding = 0) readonly buffer Materials
+{
+    Material materials[];
+};
+
+layout(binding = 1) uniform sampler2D textures[TEXTURE_COUNT];
+layout(binding = 3) uniform sampler2DArray textureArrays[TEXTURE_ARRAY_COUNT];
+
+#include "lighting.glsl"
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    Material material = materials[pushConstants.materialIndex];
+    // The index comes from a push constant, it is uniform across the draw
+    vec4 surfaceColor = vec4(1.0);
+    if (TEXTURED && material.diffuseArray >= 0)
+        surfaceColor = texture(textureArrays[material.diffuseArray], vec3(inFragTextureCoord, material.diffuseLayer));
+    else if (TEXTURED)
+        surfaceColor = texture(textures[material.diffuseTexture], inFragTextureCoord);
+    if (ALPHA_TEST && material.d < 1.0)
+        discard;
+    vec3 diffuse = clusteredLighting(inWorldPos);
+    outColor = surfaceColor * vec4(diffuse, 1.0) * material.Kd * material.illum;
+}
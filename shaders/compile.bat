@@ -1,6 +1,8 @@
 %VULKAN_SDK%/Bin/glslangValidator.exe -V material.vert -o material.vert.spv
 %VULKAN_SDK%/Bin/glslangValidator.exe -V material.frag -o material.frag.spv
-%VULKAN_SDK%/Bin/glslangValidator.exe -V materialTexture.vert -o materialTexture.vert.spv
-%VULKAN_SDK%/Bin/glslangValidator.exe -V materialTexture.frag -o materialTexture.frag.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V bindless.frag -o bindless.frag.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V culling.comp -o culling.comp.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V depthPyramid.comp -o depthPyramid.comp.spv
+%VULKAN_SDK%/Bin/glslangValidator.exe -V meshletCulling.comp -o meshletCulling.comp.spv
 
 pause
@@ -0,0 +1,37 @@
+// Clustered point lights of LightManager, the sizes must match LightManager.h
+#define MAX_LIGHTS 4096
+#define CLUSTER_COUNT (16 * 9 * 24)
+
+struct PointLight
+{
+    vec4 position; // range in w
+    vec4 color;
+};
+
+layout(std430, binding = 2) readonly buffer Lighting
+{
+    mat4 view;
+    vec4 clusterScale; // clusters per pixel in xy, log2 depth scale and bias in zw
+    uvec4 clusterCount; // light count in w
+    PointLight lights[MAX_LIGHTS];
+    uvec2 clusters[CLUSTER_COUNT]; // first light index and count
+    uint lightIndices[];
+} lighting;
+
+// Sum of the lights of the cluster of the fragment, each fading out over its range
+vec3 clusteredLighting(vec3 worldPos)
+{
+    float depth = max(-(lighting.view * vec4(worldPos, 1.0)).z, 1e-4);
+    ivec3 cluster = ivec3(gl_FragCoord.xy * lighting.clusterScale.xy, floor(log2(depth) * lighting.clusterScale.z + lighting.clusterScale.w));
+    cluster = clamp(cluster, ivec3(0), ivec3(lighting.clusterCount.xyz) - 1);
+    uvec2 range = lighting.clusters[(cluster.z * lighting.clusterCount.y + cluster.y) * lighting.clusterCount.x + cluster.x];
+    vec3 diffuse = vec3(0.0);
+    for (uint i = range.x; i < range.x + range.y; ++i)
+    {
+        PointLight light = lighting.lights[lighting.lightIndices[i]];
+        vec3 toLight = light.position.xyz - worldPos;
+        float range2 = light.position.w * light.position.w;
+        diffuse += light.color.rgb * (1.0 - min(dot(toLight, toLight), range2) / range2);
+    }
+    return (diffuse);
+}
@@ -1,10 +1,14 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 inFragColor;
 layout(location = 1) in vec2 inFragTextureCoord;
-layout(location = 2) in vec4 inLightPos;
-layout(location = 3) in vec3 inLightColor;
+layout(location = 2) in vec3 inWorldPos;
+
+// Variants of the material, specialised when the pipeline is built
+layout(constant_id = 0) const bool TEXTURED = false;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
 
 layout(binding = 0) uniform UBO 
 {
@@ -19,17 +23,17 @@ layout(binding = 0) uniform UBO
     int illum; // illum
 } ubo;
 
-layout(location = 0) out vec4 outColor;
+layout(binding = 1) uniform sampler2D textureSampler;
 
-#define MAX_LIGHT_DIST 9.0 * 9.0
+#include "lighting.glsl"
+
+layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    float lRadius =  MAX_LIGHT_DIST * inLightPos.w;
-    float dist = min(dot(inLightPos, inLightPos), lRadius) / lRadius;
-    float distFactor = 1.0 - dist;
-    vec3 diffuse = inLightColor * distFactor;
-    if (ubo.d < 1.0)
+    vec4 surfaceColor = TEXTURED ? texture(textureSampler, inFragTextureCoord) : vec4(1.0);
+    if (ALPHA_TEST && ubo.d < 1.0)
         discard;
-    outColor = vec4(diffuse, 1.0) * ubo.Kd * ubo.illum;
+    vec3 diffuse = clusteredLighting(inWorldPos);
+    outColor = surfaceColor * vec4(diffuse, 1.0) * ubo.Kd * ubo.illum;
 }
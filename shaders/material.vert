@@ -11,16 +11,9 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTextureCoord;
 
-layout(binding = 2) uniform Light
-{
-    vec4 position;
-    vec3 color;
-} light;
-
 layout(location = 0) out vec3 outFragColor;
 layout(location = 1) out vec2 outFragTextureCoord;
-layout(location = 2) out vec4 outLightPos;
-layout(location = 3) out vec3 outLightColor;
+layout(location = 2) out vec3 outWorldPos;
 
 out gl_PerVertex
 {
@@ -35,7 +28,5 @@ void main()
     
     gl_Position = pushConstants.mvp * pushConstants.transform * vec4(inPosition, 1.0);
     
-    vec4 worldPos = pushConstants.transform * vec4(inPosition, 1.0);
-    outLightPos = vec4(light.position.xyz - worldPos.xyz, light.position.w);
-    outLightColor = light.color;
+    outWorldPos = vec3(pushConstants.transform * vec4(inPosition, 1.0));
 }
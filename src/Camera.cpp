@@ -76,6 +76,37 @@ namespace Dwarf
 		return (this->_mvp);
 	}
 
+	const glm::mat4 &Camera::getView() const
+	{
+		return (this->_view);
+	}
+
+	const glm::mat4 &Camera::getProjection() const
+	{
+		return (this->_perspective);
+	}
+
+	float Camera::getNear() const
+	{
+		return (this->_zNear);
+	}
+
+	float Camera::getFar() const
+	{
+		return (this->_zFar);
+	}
+
+	glm::vec3 Camera::getEyePosition() const
+	{
+		// The view matrix translates by _position, the eye sits at its opposite
+		return (-this->_position);
+	}
+
+	float Camera::getFov() const
+	{
+		return (this->_fov);
+	}
+
 	void Camera::updateViewMatrix()
 	{
 		glm::mat4 rotM = glm::mat4();
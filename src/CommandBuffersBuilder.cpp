@@ -2,8 +2,8 @@
 
 namespace Dwarf
 {
-    CommandBuffersBuilder::CommandBuffersBuilder(const vk::Device &device, const vk::RenderPass &renderPass, std::vector<vk::Framebuffer> &swapChainFramebuffers, const vk::Extent2D &swapChainExtent, ThreadPool &threadPool, const uint32_t &numThreads)
-        : _device(device), _renderPass(renderPass), _swapChainFramebuffers(swapChainFramebuffers), _swapChainExtent(swapChainExtent), _threadPool(threadPool), _numThreads(numThreads)
+    CommandBuffersBuilder::CommandBuffersBuilder(const vk::Device &device, const vk::RenderPass &renderPass, const vk::RenderPass &renderPassLoad, std::vector<vk::Framebuffer> &swapChainFramebuffers, const vk::Extent2D &swapChainExtent, ThreadPool &threadPool, const uint32_t &numThreads)
+        : _device(device), _renderPass(renderPass), _renderPassLoad(renderPassLoad), _swapChainFramebuffers(swapChainFramebuffers), _swapChainExtent(swapChainExtent), _threadPool(threadPool), _numThreads(numThreads), _renderQueue(threadPool, numThreads)
     {
     }
 
@@ -28,71 +28,87 @@ namespace Dwarf
         }
     }
 
-    void CommandBuffersBuilder::createCommandBuffers(const vk::Queue &graphicsQueue, vk::PhysicalDeviceMemoryProperties &memProperties)
+    void CommandBuffersBuilder::createBuildableBuffers(const vk::Queue &graphicsQueue, const vk::PhysicalDeviceMemoryProperties &memProperties)
     {
-        uint32_t minObjectsPerThread = static_cast<uint32_t>(this->_buildables.size()) / this->_numThreads;
-        this->_orderedBuildables.clear();
-        this->_orderedBuildables.resize(this->_numThreads);
         uint32_t i = 0;
-        uint32_t j;
 
         for (auto &buildable : this->_buildables)
         {
             if (i >= this->_numThreads)
                 i = 0;
-            this->_orderedBuildables.at(i).push_back(buildable);
+            buildable->setCommandPool(&this->_commandPools.at(i));
+            buildable->createBuffers(this->_device, graphicsQueue, memProperties);
             ++i;
         }
-        std::vector<vk::CommandBuffer> commandBuffers;
-        vk::CommandBufferAllocateInfo cmdBufferAllocInfo;
+    }
+
+    void CommandBuffersBuilder::createCommandBuffers()
+    {
+        uint32_t i = 0;
 
-        i = 0;
-        for (auto &buildables : this->_orderedBuildables)
+        this->_secondaryCommandBuffers.resize(this->_numThreads);
+        for (auto &commandBuffers : this->_secondaryCommandBuffers)
         {
-            if (!buildables.empty())
+            if (commandBuffers.size() == this->_swapChainFramebuffers.size())
             {
-                cmdBufferAllocInfo = vk::CommandBufferAllocateInfo(this->_commandPools.at(i), vk::CommandBufferLevel::eSecondary, static_cast<uint32_t>(buildables.size()));
-                commandBuffers = this->_device.allocateCommandBuffers(cmdBufferAllocInfo);
-                j = 0;
-                for (auto &buildable : buildables)
-                {
-                    buildable->setCommandPool(&this->_commandPools.at(i));
-                    buildable->createBuffers(this->_device, graphicsQueue, memProperties);
-                    buildable->setCommandBuffer(commandBuffers.at(j));
-                    ++j;
-                }
+                ++i;
+                continue;
             }
+            if (!commandBuffers.empty())
+                this->_device.freeCommandBuffers(this->_commandPools.at(i), commandBuffers);
+            vk::CommandBufferAllocateInfo cmdBufferAllocInfo(this->_commandPools.at(i), vk::CommandBufferLevel::eSecondary, static_cast<uint32_t>(this->_swapChainFramebuffers.size()));
+            commandBuffers = this->_device.allocateCommandBuffers(cmdBufferAllocInfo);
             ++i;
         }
     }
 
-    void CommandBuffersBuilder::buildCommandBuffers(const std::vector<vk::CommandBuffer> &commandBuffers, const glm::mat4 &mvp)
+    void CommandBuffersBuilder::buildCommandBuffers(const std::vector<vk::CommandBuffer> &commandBuffers, const glm::mat4 &mvp, CullingManager &cullingManager)
     {
         std::vector<vk::CommandBuffer> builtCommandBuffers;
         vk::CommandBufferBeginInfo beginInfo;
         std::array<vk::ClearValue, 2> clearValues = { vk::ClearValue(vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f})), vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0)) };
         vk::RenderPassBeginInfo renderPassInfo(this->_renderPass, vk::Framebuffer(), vk::Rect2D(vk::Offset2D(0, 0), this->_swapChainExtent), static_cast<uint32_t>(clearValues.size()), clearValues.data());
+        vk::RenderPassBeginInfo renderPassLoadInfo(this->_renderPassLoad, vk::Framebuffer(), vk::Rect2D(vk::Offset2D(0, 0), this->_swapChainExtent));
         vk::CommandBufferInheritanceInfo inheritanceInfo(this->_renderPass);
         uint32_t i = 0;
         uint32_t j;
+
+        // Sorted once, the order does not depend on the swap chain image
+        this->_renderQueue.clear();
+        for (const auto &buildable : this->_buildables)
+            buildable->enqueue(this->_renderQueue, mvp);
+        this->_renderQueue.sort();
+        size_t drawCount = this->_renderQueue.getItems().size();
         for (const auto &commandBuffer : commandBuffers)
         {
             builtCommandBuffers.clear();
             renderPassInfo.framebuffer = this->_swapChainFramebuffers.at(i);
+            renderPassLoadInfo.framebuffer = this->_swapChainFramebuffers.at(i);
             inheritanceInfo.framebuffer = this->_swapChainFramebuffers.at(i);
             commandBuffer.begin(beginInfo);
+            cullingManager.recordCulling(commandBuffer, mvp, EARLY);
             commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
-            j = 0;
-            for (const auto &buildables : this->_orderedBuildables)
+            // Contiguous ranges keep the binds shared by neighbouring draws, executed in thread order they keep the sort
+            for (j = 0; j < this->_numThreads; ++j)
             {
-                for (const auto &buildable : buildables)
-                    this->_threadPool.addJobThread(j, std::bind(&IBuildable::buildCommandBuffer, buildable, inheritanceInfo, mvp, this->_swapChainExtent));
-                ++j;
+                size_t begin = drawCount * j / this->_numThreads;
+                size_t end = drawCount * (j + 1) / this->_numThreads;
+                if (begin == end)
+                    continue;
+                const vk::CommandBuffer &secondary = this->_secondaryCommandBuffers.at(j).at(i);
+                this->_threadPool.addJobThread(j, std::bind(&CommandBuffersBuilder::recordDraws, this, secondary, inheritanceInfo, mvp, begin, end));
+                builtCommandBuffers.push_back(secondary);
             }
             this->_threadPool.wait();
-            for (const auto &buildable : this->_buildables)
-                builtCommandBuffers.push_back(buildable->getCommandBuffer());
-            commandBuffer.executeCommands(builtCommandBuffers);
+            if (!builtCommandBuffers.empty())
+                commandBuffer.executeCommands(builtCommandBuffers);
+            commandBuffer.endRenderPass();
+            // The secondaries draw indirectly, the late phase only rewrites their draw commands
+            cullingManager.recordDepthPyramid(commandBuffer);
+            cullingManager.recordCulling(commandBuffer, mvp, LATE);
+            commandBuffer.beginRenderPass(renderPassLoadInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+            if (!builtCommandBuffers.empty())
+                commandBuffer.executeCommands(builtCommandBuffers);
             commandBuffer.endRenderPass();
             commandBuffer.end();
             ++i;
@@ -108,4 +124,19 @@ namespace Dwarf
     {
         this->_buildables.insert(this->_buildables.end(), buildables.begin(), buildables.end());
     }
+
+    void CommandBuffersBuilder::recordDraws(const vk::CommandBuffer &commandBuffer, const vk::CommandBufferInheritanceInfo &inheritanceInfo, const glm::mat4 &mvp, size_t begin, size_t end) const
+    {
+        const std::vector<RenderItem> &items = this->_renderQueue.getItems();
+        DrawState state;
+
+        commandBuffer.reset(vk::CommandBufferResetFlags());
+        vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse, &inheritanceInfo);
+        commandBuffer.begin(beginInfo);
+        commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(this->_swapChainExtent.width), static_cast<float>(this->_swapChainExtent.height), 0.0f, 1.0f));
+        commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), this->_swapChainExtent));
+        for (size_t i = begin; i < end; ++i)
+            items.at(i).buildable->recordDraw(commandBuffer, mvp, state);
+        commandBuffer.end();
+    }
 }
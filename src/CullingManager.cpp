@@ -0,0 +1,369 @@
+#include "CullingManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define CULLING_GROUP_SIZE 64
+#define CULLING_MAX_GROUP_COUNT 65535
+
+namespace Dwarf
+{
+    CullingManager::CullingManager(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator)
+        : _device(device), _memProperties(memProperties), _pipelineCache(pipelineCache), _shaderLibrary(shaderLibrary), _descriptorAllocator(descriptorAllocator), _depthPyramid(device, memProperties, graphicsQueue, commandPool, pipelineCache, shaderLibrary, descriptorAllocator), _meshletIndexCount(0), _mappedInstances(nullptr), _mappedVisibility(nullptr), _mappedUniformBuffer(nullptr)
+    {
+        this->_uniformBuffer.instanceCount = 0;
+        this->_uniformBuffer.occlusionCulling = VK_TRUE;
+        this->_uniformBuffer.lodScale = 0.0f;
+        this->_uniformBuffer.lodThreshold = 1.0f;
+        this->_uniformBuffer.meshletCount = 0;
+        // w stays 0 until the camera is known, which disables the normal cone test
+        this->_uniformBuffer.cameraPosition = glm::vec4(0.0f);
+    }
+
+    CullingManager::~CullingManager()
+    {
+        this->_device.destroyPipeline(this->_meshletPipeline, CUSTOM_ALLOCATOR);
+        this->_device.destroyPipeline(this->_pipeline, CUSTOM_ALLOCATOR);
+        this->_device.destroyPipelineLayout(this->_pipelineLayout, CUSTOM_ALLOCATOR);
+        if (this->_descriptorSet)
+            this->_descriptorAllocator.free(this->_descriptorSetLayout, this->_descriptorSet);
+        this->_device.destroyDescriptorSetLayout(this->_descriptorSetLayout, CUSTOM_ALLOCATOR);
+        if (this->_mappedInstances)
+            this->_device.unmapMemory(this->_instanceBufferMemory);
+        if (this->_mappedVisibility)
+            this->_device.unmapMemory(this->_visibilityBufferMemory);
+        if (this->_mappedUniformBuffer)
+            this->_device.unmapMemory(this->_cullingUniformBufferMemory);
+        this->_device.freeMemory(this->_instanceBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_instanceBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_drawCommandBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_drawCommandBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_visibilityBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_visibilityBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_historyBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_historyBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_meshletBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_meshletBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_meshletIndexBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_meshletIndexBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_cullingUniformBufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_cullingUniformBuffer, CUSTOM_ALLOCATOR);
+    }
+
+    void CullingManager::build(std::vector<Mesh *> &meshes)
+    {
+        CullingInstance instance = {};
+        CullingMeshlet cullingMeshlet = {};
+        uint32_t lod;
+
+        for (auto &mesh : meshes)
+        {
+            for (auto &submesh : mesh->getSubmeshes())
+            {
+                if (submesh.getVerticesCount() == 0 || submesh.getIndicesCount() == 0)
+                    continue;
+                instance.transform = submesh.getTransform();
+                instance.boundingSphere = submesh.getBoundingSphere();
+                instance.lodCount = static_cast<uint32_t>(std::min<size_t>(submesh.getLods().size(), DWARF_MAX_LODS));
+                for (lod = 0; lod < instance.lodCount; ++lod)
+                {
+                    instance.lodFirstIndex[lod] = submesh.getLods().at(lod).firstIndex;
+                    instance.lodIndexCount[lod] = submesh.getLods().at(lod).indexCount;
+                    instance.lodError[lod] = submesh.getLods().at(lod).error;
+                }
+                // Meshlets index the shared index buffer of the device allocator, as a storage buffer
+                instance.meshletIndexOffset = this->_meshletIndexCount;
+                instance.meshletCount = static_cast<uint32_t>(submesh.getMeshlets().size());
+                // A single descriptor binds the source indices, every submesh must live in the same allocation
+                if (this->_sourceIndexBuffer && submesh.getBuffer() != this->_sourceIndexBuffer)
+                    Tools::exitOnError("CullingManager: submeshes are spread over several device buffers");
+                this->_sourceIndexBuffer = submesh.getBuffer();
+                cullingMeshlet.instance = static_cast<uint32_t>(this->_instances.size());
+                for (const auto &meshlet : submesh.getMeshlets())
+                {
+                    cullingMeshlet.boundingSphere = meshlet.boundingSphere;
+                    cullingMeshlet.cone = meshlet.cone;
+                    cullingMeshlet.firstIndex = static_cast<uint32_t>(submesh.getIndexBufferOffset() / sizeof(uint32_t)) + meshlet.firstIndex;
+                    cullingMeshlet.indexCount = meshlet.indexCount;
+                    this->_meshlets.push_back(cullingMeshlet);
+                }
+                if (instance.meshletCount > 0)
+                    this->_meshletIndexCount += submesh.getLods().front().indexCount;
+                this->_instances.push_back(instance);
+                this->_submeshes.push_back(&submesh);
+            }
+        }
+        this->_uniformBuffer.instanceCount = static_cast<uint32_t>(this->_instances.size());
+        this->_uniformBuffer.meshletCount = static_cast<uint32_t>(this->_meshlets.size());
+        if (this->_instances.empty())
+            return;
+        this->createBuffers();
+        this->createDescriptorSet();
+        this->createPipelines();
+        uint32_t i = 0;
+        for (auto &submesh : this->_submeshes)
+        {
+            submesh->setDrawCommandBuffer(this->_drawCommandBuffer, sizeof(vk::DrawIndexedIndirectCommand) * 2 * i);
+            if (this->_instances.at(i).meshletCount > 0)
+                submesh->setMeshletDraw(this->_meshletIndexBuffer, sizeof(uint32_t) * this->_instances.at(i).meshletIndexOffset, sizeof(vk::DrawIndexedIndirectCommand) * (2 * i + 1));
+            ++i;
+        }
+    }
+
+    void CullingManager::createDepthPyramid(const vk::ImageView &depthImageView, const vk::Extent2D &depthExtent)
+    {
+        this->_depthPyramid.create(depthImageView, depthExtent);
+        this->_uniformBuffer.pyramidSize = this->_depthPyramid.getSize();
+        if (this->_descriptorSet)
+        {
+            vk::WriteDescriptorSet descriptorWrite(this->_descriptorSet, 5, 0, 1, vk::DescriptorType::eCombinedImageSampler, &this->_depthPyramid.getDescriptorImageInfo());
+            this->_device.updateDescriptorSets(descriptorWrite, nullptr);
+        }
+    }
+
+    void CullingManager::update()
+    {
+        if (!this->_mappedInstances)
+            return;
+        size_t i = 0;
+        CullingInstance *instances = reinterpret_cast<CullingInstance *>(this->_mappedInstances);
+        for (const auto &submesh : this->_submeshes)
+        {
+            this->_instances.at(i).transform = submesh->getTransform();
+            instances[i].transform = this->_instances.at(i).transform;
+            ++i;
+        }
+    }
+
+    void CullingManager::recordCulling(const vk::CommandBuffer &commandBuffer, const glm::mat4 &viewProjection, CullingPhase phase)
+    {
+        if (this->_instances.empty())
+            return;
+        uint32_t phaseValue = static_cast<uint32_t>(phase);
+        vk::BufferMemoryBarrier drawCommandBarrier(vk::AccessFlagBits::eIndirectCommandRead, vk::AccessFlagBits::eShaderWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_drawCommandBuffer, 0, VK_WHOLE_SIZE);
+        if (phase == EARLY)
+        {
+            this->_uniformBuffer.viewProjection = viewProjection;
+            this->_uniformBuffer.frustumPlanes = CullingManager::extractFrustumPlanes(viewProjection);
+            memcpy(this->_mappedUniformBuffer, &this->_uniformBuffer, sizeof(CullingUniformBuffer));
+            vk::BufferMemoryBarrier visibilityBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_visibilityBuffer, 0, VK_WHOLE_SIZE);
+            commandBuffer.fillBuffer(this->_visibilityBuffer, 0, sizeof(uint32_t), 0);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 0, nullptr, 1, &visibilityBarrier, 0, nullptr);
+        }
+        else
+        {
+            // The late phase appends to the visibility list and rewrites the history the early phase read
+            vk::MemoryBarrier earlyPhaseBarrier(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &earlyPhaseBarrier, 0, nullptr, 0, nullptr);
+        }
+        vk::BufferMemoryBarrier meshletIndexBarrier(vk::AccessFlagBits::eIndexRead, vk::AccessFlagBits::eShaderWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_meshletIndexBuffer, 0, VK_WHOLE_SIZE);
+        std::array<vk::BufferMemoryBarrier, 2> bufferBarriers = { drawCommandBarrier, meshletIndexBarrier };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->_pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->_pipelineLayout, 0, this->_descriptorSet, nullptr);
+        commandBuffer.pushConstants<uint32_t>(this->_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, phaseValue);
+        commandBuffer.dispatch((this->_uniformBuffer.instanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+        if (!this->_meshlets.empty())
+        {
+            // One workgroup per meshlet, it reads the draw decision of its instance and appends to its count
+            drawCommandBarrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_drawCommandBuffer, 0, VK_WHOLE_SIZE);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 0, nullptr, 1, &drawCommandBarrier, 0, nullptr);
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->_meshletPipeline);
+            uint32_t meshletCount = static_cast<uint32_t>(this->_meshlets.size());
+            commandBuffer.dispatch(std::min<uint32_t>(meshletCount, CULLING_MAX_GROUP_COUNT), (meshletCount + CULLING_MAX_GROUP_COUNT - 1) / CULLING_MAX_GROUP_COUNT, 1);
+        }
+        drawCommandBarrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_drawCommandBuffer, 0, VK_WHOLE_SIZE);
+        meshletIndexBarrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndexRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_meshletIndexBuffer, 0, VK_WHOLE_SIZE);
+        bufferBarriers = { drawCommandBarrier, meshletIndexBarrier };
+        vk::BufferMemoryBarrier visibilityBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->_visibilityBuffer, 0, VK_WHOLE_SIZE);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput, vk::DependencyFlags(), 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+        if (phase == LATE)
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), 0, nullptr, 1, &visibilityBarrier, 0, nullptr);
+    }
+
+    void CullingManager::recordDepthPyramid(const vk::CommandBuffer &commandBuffer)
+    {
+        if (this->_instances.empty() || !this->_uniformBuffer.occlusionCulling)
+            return;
+        this->_depthPyramid.recordBuild(commandBuffer);
+    }
+
+    void CullingManager::cullOnCpu(const std::array<glm::vec4, 6> &frustumPlanes, std::vector<uint32_t> &visibleInstances) const
+    {
+        glm::vec3 center;
+        float scale;
+        float radius;
+        bool visible;
+        uint32_t i = 0;
+
+        visibleInstances.clear();
+        for (const auto &instance : this->_instances)
+        {
+            center = glm::vec3(instance.transform * glm::vec4(glm::vec3(instance.boundingSphere), 1.0f));
+            scale = std::max(std::max(glm::length(glm::vec3(instance.transform[0])), glm::length(glm::vec3(instance.transform[1]))), glm::length(glm::vec3(instance.transform[2])));
+            radius = instance.boundingSphere.w * scale;
+            visible = true;
+            for (const auto &plane : frustumPlanes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (visible)
+                visibleInstances.push_back(i);
+            ++i;
+        }
+    }
+
+    bool CullingManager::validate() const
+    {
+        if (!this->_mappedVisibility)
+            return (true);
+        std::vector<uint32_t> expected;
+        this->cullOnCpu(this->_uniformBuffer.frustumPlanes, expected);
+        std::vector<uint32_t> result(this->_mappedVisibility + 1, this->_mappedVisibility + 1 + std::min(this->_mappedVisibility[0], this->_uniformBuffer.instanceCount));
+        std::sort(result.begin(), result.end());
+        bool valid;
+        if (this->_uniformBuffer.occlusionCulling)
+            valid = std::adjacent_find(result.begin(), result.end()) == result.end() && std::includes(expected.begin(), expected.end(), result.begin(), result.end());
+        else
+            valid = (result == expected);
+        if (!valid)
+            LOG(WARNING) << "GPU culling mismatch: " << result.size() << " visible instances on the GPU, " << expected.size() << " with the CPU reference";
+        return (valid);
+    }
+
+    void CullingManager::setOcclusionCulling(bool occlusionCulling)
+    {
+        this->_uniformBuffer.occlusionCulling = occlusionCulling ? VK_TRUE : VK_FALSE;
+    }
+
+    void CullingManager::setLodSelection(const glm::vec3 &cameraPosition, float fov, float viewportHeight)
+    {
+        this->_uniformBuffer.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+        this->_uniformBuffer.lodScale = viewportHeight / (2.0f * std::tan(glm::radians(fov) * 0.5f));
+    }
+
+    void CullingManager::setLodThreshold(float lodThreshold)
+    {
+        this->_uniformBuffer.lodThreshold = lodThreshold;
+    }
+
+    uint32_t CullingManager::getVisibleCount() const
+    {
+        if (!this->_mappedVisibility)
+            return (0);
+        return (this->_mappedVisibility[0]);
+    }
+
+    uint32_t CullingManager::getInstanceCount() const
+    {
+        return (this->_uniformBuffer.instanceCount);
+    }
+
+    std::array<glm::vec4, 6> CullingManager::extractFrustumPlanes(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+        // Depth is in [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE) so the near plane is the third row alone
+        std::array<glm::vec4, 6> planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+
+        for (auto &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+        return (planes);
+    }
+
+    void CullingManager::createBuffers()
+    {
+        vk::DeviceSize instancesSize = sizeof(CullingInstance) * this->_instances.size();
+        vk::DeviceSize drawCommandsSize = sizeof(vk::DrawIndexedIndirectCommand) * 2 * this->_instances.size();
+        vk::DeviceSize visibilitySize = sizeof(uint32_t) * (this->_instances.size() + 1);
+        vk::DeviceSize historySize = sizeof(uint32_t) * this->_instances.size();
+        vk::DeviceSize meshletsSize = sizeof(CullingMeshlet) * std::max<size_t>(this->_meshlets.size(), 1);
+        vk::DeviceSize meshletIndicesSize = sizeof(uint32_t) * std::max<uint32_t>(this->_meshletIndexCount, 1);
+
+        Tools::createBuffer(this->_device, this->_memProperties, instancesSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_instanceBuffer, this->_instanceBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, drawCommandsSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_drawCommandBuffer, this->_drawCommandBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, visibilitySize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_visibilityBuffer, this->_visibilityBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, historySize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_historyBuffer, this->_historyBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, meshletsSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_meshletBuffer, this->_meshletBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, meshletIndicesSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_meshletIndexBuffer, this->_meshletIndexBufferMemory);
+        Tools::createBuffer(this->_device, this->_memProperties, sizeof(CullingUniformBuffer), vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_cullingUniformBuffer, this->_cullingUniformBufferMemory);
+        this->_mappedInstances = this->_device.mapMemory(this->_instanceBufferMemory, 0, instancesSize);
+        memcpy(this->_mappedInstances, this->_instances.data(), static_cast<size_t>(instancesSize));
+        if (!this->_meshlets.empty())
+        {
+            void *meshlets = this->_device.mapMemory(this->_meshletBufferMemory, 0, meshletsSize);
+            memcpy(meshlets, this->_meshlets.data(), sizeof(CullingMeshlet) * this->_meshlets.size());
+            this->_device.unmapMemory(this->_meshletBufferMemory);
+        }
+        this->_mappedVisibility = reinterpret_cast<uint32_t *>(this->_device.mapMemory(this->_visibilityBufferMemory, 0, visibilitySize));
+        this->_mappedVisibility[0] = 0;
+        // Nothing was visible before the first frame, everything goes through the late phase with its finest level of detail
+        void *history = this->_device.mapMemory(this->_historyBufferMemory, 0, historySize);
+        memset(history, 0, static_cast<size_t>(historySize));
+        this->_device.unmapMemory(this->_historyBufferMemory);
+        this->_mappedUniformBuffer = this->_device.mapMemory(this->_cullingUniformBufferMemory, 0, sizeof(CullingUniformBuffer));
+    }
+
+    void CullingManager::createDescriptorSet()
+    {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings =
+        {
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(8, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute)
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo(vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data());
+        this->_descriptorSetLayout = this->_device.createDescriptorSetLayout(layoutInfo, CUSTOM_ALLOCATOR);
+        this->_descriptorAllocator.addLayout(this->_descriptorSetLayout, bindings);
+        this->_descriptorSet = this->_descriptorAllocator.allocate(this->_descriptorSetLayout);
+        vk::DescriptorBufferInfo instancesInfo(this->_instanceBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo drawCommandsInfo(this->_drawCommandBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo visibilityInfo(this->_visibilityBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo historyInfo(this->_historyBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo uniformBufferInfo(this->_cullingUniformBuffer, 0, sizeof(CullingUniformBuffer));
+        vk::DescriptorBufferInfo meshletsInfo(this->_meshletBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo sourceIndicesInfo(this->_sourceIndexBuffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo meshletIndicesInfo(this->_meshletIndexBuffer, 0, VK_WHOLE_SIZE);
+        std::vector<vk::WriteDescriptorSet> descriptorWrites =
+        {
+            vk::WriteDescriptorSet(this->_descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &instancesInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &drawCommandsInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &visibilityInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &historyInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 4, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &uniformBufferInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 5, 0, 1, vk::DescriptorType::eCombinedImageSampler, &this->_depthPyramid.getDescriptorImageInfo()),
+            vk::WriteDescriptorSet(this->_descriptorSet, 6, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletsInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 7, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &sourceIndicesInfo),
+            vk::WriteDescriptorSet(this->_descriptorSet, 8, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletIndicesInfo)
+        };
+        this->_device.updateDescriptorSets(descriptorWrites, nullptr);
+    }
+
+    void CullingManager::createPipelines()
+    {
+        vk::PushConstantRange pushConstantInfo(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo(vk::PipelineLayoutCreateFlags(), 1, &this->_descriptorSetLayout, 1, &pushConstantInfo);
+        this->_pipelineLayout = this->_device.createPipelineLayout(pipelineLayoutInfo, CUSTOM_ALLOCATOR);
+        this->_pipeline = this->createComputePipeline("shaders/culling.comp.spv");
+        this->_meshletPipeline = this->createComputePipeline("shaders/meshletCulling.comp.spv");
+    }
+
+    vk::Pipeline CullingManager::createComputePipeline(const std::string &shaderPath) const
+    {
+        vk::PipelineShaderStageCreateInfo shaderStage(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, this->_shaderLibrary.getModule(shaderPath), "main");
+        vk::ComputePipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(), shaderStage, this->_pipelineLayout, VK_NULL_HANDLE, -1);
+        return (this->_pipelineCache.createComputePipeline(pipelineInfo));
+    }
+}
@@ -0,0 +1,132 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define DEPTH_PYRAMID_GROUP_SIZE 8
+
+namespace Dwarf
+{
+    DepthPyramid::DepthPyramid(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator)
+        : _device(device), _memProperties(memProperties), _graphicsQueue(graphicsQueue), _commandPool(commandPool), _pipelineCache(pipelineCache), _shaderLibrary(shaderLibrary), _descriptorAllocator(descriptorAllocator), _width(0), _height(0), _mipLevels(0)
+    {
+        vk::SamplerCreateInfo samplerInfo(vk::SamplerCreateFlags(), vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, 0.0f, VK_FALSE, 1.0f, VK_FALSE, vk::CompareOp::eAlways, 0.0f, 16.0f, vk::BorderColor::eFloatOpaqueWhite, VK_FALSE);
+        this->_sampler = this->_device.createSampler(samplerInfo, CUSTOM_ALLOCATOR);
+        this->createPipeline();
+    }
+
+    DepthPyramid::~DepthPyramid()
+    {
+        this->cleanup();
+        this->_device.destroyPipeline(this->_pipeline, CUSTOM_ALLOCATOR);
+        this->_device.destroyPipelineLayout(this->_pipelineLayout, CUSTOM_ALLOCATOR);
+        this->_device.destroyDescriptorSetLayout(this->_descriptorSetLayout, CUSTOM_ALLOCATOR);
+        this->_device.destroySampler(this->_sampler, CUSTOM_ALLOCATOR);
+    }
+
+    void DepthPyramid::create(const vk::ImageView &depthImageView, const vk::Extent2D &depthExtent)
+    {
+        this->cleanup();
+        this->_width = std::max(1u, (depthExtent.width + 1) / 2);
+        this->_height = std::max(1u, (depthExtent.height + 1) / 2);
+        this->_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(this->_width, this->_height)))) + 1;
+        Tools::createImage(this->_device, this->_memProperties, this->_width, this->_height, vk::Format::eR32Sfloat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_image, this->_imageMemory, this->_mipLevels);
+        Tools::transitionImageLayout(this->_device, this->_graphicsQueue, this->_commandPool, this->_image, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, this->_mipLevels);
+        Tools::createImageView(this->_device, this->_image, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, this->_imageView, 0, this->_mipLevels);
+        this->_imageInfo = vk::DescriptorImageInfo(this->_sampler, this->_imageView, vk::ImageLayout::eGeneral);
+        this->_depthImageView = depthImageView;
+
+        PushConstants sizes;
+        sizes.inputWidth = depthExtent.width;
+        sizes.inputHeight = depthExtent.height;
+        this->_levelViews.resize(this->_mipLevels);
+        uint32_t level = 0;
+        for (auto &levelView : this->_levelViews)
+        {
+            Tools::createImageView(this->_device, this->_image, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, levelView, level, 1);
+            sizes.outputWidth = std::max(1u, this->_width >> level);
+            sizes.outputHeight = std::max(1u, this->_height >> level);
+            this->_levelSizes.push_back(sizes);
+            sizes.inputWidth = sizes.outputWidth;
+            sizes.inputHeight = sizes.outputHeight;
+            ++level;
+        }
+    }
+
+    void DepthPyramid::recordBuild(const vk::CommandBuffer &commandBuffer)
+    {
+        vk::DescriptorSet descriptorSet;
+        vk::DescriptorImageInfo inputInfo(this->_sampler, this->_depthImageView, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+        vk::DescriptorImageInfo outputInfo;
+
+        if (!this->_image)
+            return;
+        vk::MemoryBarrier previousReadsBarrier(vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite);
+        vk::MemoryBarrier levelBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &previousReadsBarrier, 0, nullptr, 0, nullptr);
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, this->_pipeline);
+        uint32_t level = 0;
+        for (const auto &sizes : this->_levelSizes)
+        {
+            // Reset in bulk with the frame instead of being kept and freed on resize
+            descriptorSet = this->_descriptorAllocator.allocateTransient(this->_descriptorSetLayout);
+            outputInfo = vk::DescriptorImageInfo(vk::Sampler(), this->_levelViews.at(level), vk::ImageLayout::eGeneral);
+            std::vector<vk::WriteDescriptorSet> descriptorWrites = {
+                vk::WriteDescriptorSet(descriptorSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &inputInfo),
+                vk::WriteDescriptorSet(descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageImage, &outputInfo)
+            };
+            this->_device.updateDescriptorSets(descriptorWrites, nullptr);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->_pipelineLayout, 0, descriptorSet, nullptr);
+            commandBuffer.pushConstants<PushConstants>(this->_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizes);
+            commandBuffer.dispatch((sizes.outputWidth + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, (sizes.outputHeight + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &levelBarrier, 0, nullptr, 0, nullptr);
+            inputInfo = vk::DescriptorImageInfo(this->_sampler, this->_levelViews.at(level), vk::ImageLayout::eGeneral);
+            ++level;
+        }
+    }
+
+    const vk::DescriptorImageInfo &DepthPyramid::getDescriptorImageInfo() const
+    {
+        return (this->_imageInfo);
+    }
+
+    glm::vec2 DepthPyramid::getSize() const
+    {
+        return (glm::vec2(static_cast<float>(this->_width), static_cast<float>(this->_height)));
+    }
+
+    void DepthPyramid::createPipeline()
+    {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings =
+        {
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute)
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo(vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data());
+        this->_descriptorSetLayout = this->_device.createDescriptorSetLayout(layoutInfo, CUSTOM_ALLOCATOR);
+        this->_descriptorAllocator.addLayout(this->_descriptorSetLayout, bindings);
+        vk::PushConstantRange pushConstantInfo(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants));
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo(vk::PipelineLayoutCreateFlags(), 1, &this->_descriptorSetLayout, 1, &pushConstantInfo);
+        this->_pipelineLayout = this->_device.createPipelineLayout(pipelineLayoutInfo, CUSTOM_ALLOCATOR);
+        vk::PipelineShaderStageCreateInfo shaderStage(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, this->_shaderLibrary.getModule("shaders/depthPyramid.comp.spv"), "main");
+        vk::ComputePipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(), shaderStage, this->_pipelineLayout, VK_NULL_HANDLE, -1);
+        this->_pipeline = this->_pipelineCache.createComputePipeline(pipelineInfo);
+    }
+
+    void DepthPyramid::cleanup()
+    {
+        for (const auto &levelView : this->_levelViews)
+            this->_device.destroyImageView(levelView, CUSTOM_ALLOCATOR);
+        this->_levelViews.clear();
+        this->_levelSizes.clear();
+        if (this->_imageView)
+            this->_device.destroyImageView(this->_imageView, CUSTOM_ALLOCATOR);
+        if (this->_imageMemory)
+            this->_device.freeMemory(this->_imageMemory, CUSTOM_ALLOCATOR);
+        if (this->_image)
+            this->_device.destroyImage(this->_image, CUSTOM_ALLOCATOR);
+        this->_imageView = vk::ImageView();
+        this->_imageMemory = vk::DeviceMemory();
+        this->_image = vk::Image();
+    }
+}
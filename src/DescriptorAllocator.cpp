@@ -0,0 +1,157 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+namespace Dwarf
+{
+    DescriptorAllocator::DescriptorAllocator(const vk::Device &device, uint32_t frameCount)
+        : _device(device), _framePools(std::max(frameCount, 1u)), _frame(0)
+    {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator()
+    {
+        this->destroy(this->_persistentPools);
+        for (auto &chain : this->_framePools)
+            this->destroy(chain);
+    }
+
+    void DescriptorAllocator::addLayout(const vk::DescriptorSetLayout &layout, const std::vector<vk::DescriptorSetLayoutBinding> &bindings)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        DescriptorCounts &layoutCounts = this->_layoutCounts[static_cast<VkDescriptorSetLayout>(layout)];
+
+        // A destroyed layout may hand its handle over to a new one
+        layoutCounts.clear();
+        for (const auto &binding : bindings)
+            layoutCounts[binding.descriptorType] += binding.descriptorCount;
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocate(const vk::DescriptorSetLayout &layout)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto freeSets = this->_freeSets.find(static_cast<VkDescriptorSetLayout>(layout));
+
+        if (freeSets != this->_freeSets.end() && !freeSets->second.empty())
+        {
+            vk::DescriptorSet descriptorSet = freeSets->second.back();
+            freeSets->second.pop_back();
+            return (descriptorSet);
+        }
+        return (this->allocate(this->_persistentPools, layout));
+    }
+
+    void DescriptorAllocator::free(const vk::DescriptorSetLayout &layout, const vk::DescriptorSet &descriptorSet)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+
+        // The pools are not created with the free flag, the set is kept for the next allocation of its layout
+        this->_freeSets[static_cast<VkDescriptorSetLayout>(layout)].push_back(descriptorSet);
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocateTransient(const vk::DescriptorSetLayout &layout)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+
+        return (this->allocate(this->_framePools.at(this->_frame), layout));
+    }
+
+    void DescriptorAllocator::beginFrame()
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+
+        this->_frame = (this->_frame + 1) % static_cast<uint32_t>(this->_framePools.size());
+        PoolChain &chain = this->_framePools.at(this->_frame);
+        for (auto &pool : chain.pools)
+        {
+            this->_device.resetDescriptorPool(pool.pool, vk::DescriptorPoolResetFlags());
+            DescriptorAllocator::resetCounts(pool);
+        }
+        chain.current = 0;
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocate(PoolChain &chain, const vk::DescriptorSetLayout &layout)
+    {
+        auto layoutCounts = this->_layoutCounts.find(static_cast<VkDescriptorSetLayout>(layout));
+
+        if (layoutCounts == this->_layoutCounts.end())
+            Tools::exitOnError("DescriptorAllocator: allocation of a layout never added");
+        for (; chain.current < chain.pools.size(); ++chain.current)
+        {
+            if (DescriptorAllocator::fits(chain.pools.at(chain.current), layoutCounts->second))
+                return (this->allocate(chain.pools.at(chain.current), layout, layoutCounts->second));
+        }
+        this->addPool(chain);
+        if (!DescriptorAllocator::fits(chain.pools.back(), layoutCounts->second))
+            Tools::exitOnError("DescriptorAllocator: layout too large for a pool");
+        return (this->allocate(chain.pools.back(), layout, layoutCounts->second));
+    }
+
+    bool DescriptorAllocator::fits(const Pool &pool, const DescriptorCounts &layoutCounts)
+    {
+        if (pool.sets == 0)
+            return (false);
+        for (const auto &layoutCount : layoutCounts)
+        {
+            auto descriptors = pool.descriptors.find(layoutCount.first);
+            if (descriptors == pool.descriptors.end() || descriptors->second < layoutCount.second)
+                return (false);
+        }
+        return (true);
+    }
+
+    vk::DescriptorSet DescriptorAllocator::allocate(Pool &pool, const vk::DescriptorSetLayout &layout, const DescriptorCounts &layoutCounts) const
+    {
+        vk::DescriptorSetAllocateInfo allocInfo(pool.pool, 1, &layout);
+        // Counted beforehand, any failure is a real error
+        vk::DescriptorSet descriptorSet = this->_device.allocateDescriptorSets(allocInfo).front();
+
+        --pool.sets;
+        for (const auto &layoutCount : layoutCounts)
+            pool.descriptors.at(layoutCount.first) -= layoutCount.second;
+        return (descriptorSet);
+    }
+
+    void DescriptorAllocator::addPool(PoolChain &chain)
+    {
+        uint32_t setCount = chain.nextSetCount;
+        std::vector<vk::DescriptorPoolSize> poolSizes = DescriptorAllocator::getPoolSizes(setCount);
+        vk::DescriptorPoolCreateInfo poolInfo(vk::DescriptorPoolCreateFlags(), setCount, static_cast<uint32_t>(poolSizes.size()), poolSizes.data());
+        Pool pool;
+
+        pool.pool = this->_device.createDescriptorPool(poolInfo, CUSTOM_ALLOCATOR);
+        pool.setCount = setCount;
+        DescriptorAllocator::resetCounts(pool);
+        chain.pools.push_back(pool);
+        chain.current = chain.pools.size() - 1;
+        chain.nextSetCount = std::min(setCount * 2, static_cast<uint32_t>(DWARF_DESCRIPTOR_POOL_MAX_SETS));
+        LOG(INFO) << "DescriptorAllocator: pool " << chain.pools.size() << " of " << setCount << " sets";
+    }
+
+    void DescriptorAllocator::resetCounts(Pool &pool)
+    {
+        pool.sets = pool.setCount;
+        pool.descriptors.clear();
+        for (const auto &poolSize : DescriptorAllocator::getPoolSizes(pool.setCount))
+            pool.descriptors[poolSize.type] = poolSize.descriptorCount;
+    }
+
+    std::vector<vk::DescriptorPoolSize> DescriptorAllocator::getPoolSizes(uint32_t setCount)
+    {
+        return (std::vector<vk::DescriptorPoolSize>
+        {
+            vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, setCount * 2),
+            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, setCount * 2),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, setCount * 2),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, setCount)
+        });
+    }
+
+    void DescriptorAllocator::destroy(PoolChain &chain)
+    {
+        for (const auto &pool : chain.pools)
+            this->_device.destroyDescriptorPool(pool.pool, CUSTOM_ALLOCATOR);
+        chain.pools.clear();
+        chain.current = 0;
+    }
+}
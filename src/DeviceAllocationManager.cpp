@@ -38,7 +38,7 @@ namespace Dwarf
                 }
             }
         }
-        vk::MemoryRequirements memoryRequirements = this->getMemoryRequirements(totalVertexBuffersSize + totalIndexBuffersSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer);
+        vk::MemoryRequirements memoryRequirements = this->getMemoryRequirements(totalVertexBuffersSize + totalIndexBuffersSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
 
         totalVertexBuffersSize = 0;
         for (auto &vertexBufferSize : separateVertexBuffersSizes)
@@ -56,7 +56,7 @@ namespace Dwarf
                 indexBufferSize = tmp;
             totalIndexBuffersSize += indexBufferSize;
         }
-        memoryRequirements = this->getMemoryRequirements(totalVertexBuffersSize + totalIndexBuffersSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer);
+        memoryRequirements = this->getMemoryRequirements(totalVertexBuffersSize + totalIndexBuffersSize, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
 
         vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo(vk::BufferCreateFlags(), memoryRequirements.size, vk::BufferUsageFlagBits::eTransferSrc);
         vk::Buffer stagingBuffer = this->_device.createBuffer(bufferInfo, CUSTOM_ALLOCATOR);
@@ -99,7 +99,7 @@ namespace Dwarf
                 }
             }
         }
-        bufferInfo = vk::BufferCreateInfo(vk::BufferCreateFlags(), memoryRequirements.size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer);
+        bufferInfo = vk::BufferCreateInfo(vk::BufferCreateFlags(), memoryRequirements.size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
         this->_buffers.push_back(this->_device.createBuffer(bufferInfo, CUSTOM_ALLOCATOR));
         memoryRequirements = this->_device.getBufferMemoryRequirements(this->_buffers.back());
         LOG(INFO) << "Size from requirements: " << memoryRequirements.size;
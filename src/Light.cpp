@@ -5,19 +5,19 @@ namespace Dwarf
     Light::Light()
         : _position(0.0, 0.0, 0.0), _radius(0.0)
     {
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
     Light::Light(double x, double y, double z, double radius)
         : _position(x, y, z), _radius(radius)
     {
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
     Light::Light(double x, double y, double z, const Color &color, double radius)
         : _position(x, y, z), _color(color), _radius(radius)
     {
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
     Light::~Light()
@@ -42,15 +42,13 @@ namespace Dwarf
     void Light::setPosition(const glm::dvec3 &position)
     {
         this->_position = position;
-        this->_uniformBuffer.position = glm::vec4(this->_position, this->_radius);
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
     void Light::setColor(const Color &color)
     {
         this->_color = color;
-        this->_uniformBuffer.color = this->_color.getColor();
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
     void Light::changeRadius(double radius)
@@ -61,18 +59,17 @@ namespace Dwarf
     void Light::setRadius(double radius)
     {
         this->_radius = radius;
-        this->_uniformBuffer.position.w = static_cast<float>(this->_radius);
-        this->updateUniformBuffer();
+        this->updateEntry();
     }
 
-    const LightUniformBuffer &Light::getUniformBuffer() const
+    const LightEntry &Light::getEntry() const
     {
-        return (this->_uniformBuffer);
+        return (this->_entry);
     }
 
-    void Light::updateUniformBuffer()
+    void Light::updateEntry()
     {
-        this->_uniformBuffer.position = glm::vec4(this->_position, this->_radius);
-        this->_uniformBuffer.color = this->_color.getColor();
+        this->_entry.position = glm::vec4(this->_position, this->_radius);
+        this->_entry.color = this->_color.getColor();
     }
 }
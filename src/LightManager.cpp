@@ -1,10 +1,23 @@
 #include "LightManager.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define LIGHTS_OFFSET sizeof(ClusterGrid)
+#define CLUSTERS_OFFSET (LIGHTS_OFFSET + sizeof(LightEntry) * DWARF_MAX_LIGHTS)
+#define INDICES_OFFSET (CLUSTERS_OFFSET + sizeof(glm::uvec2) * DWARF_CLUSTER_COUNT)
+#define LIGHTING_BUFFER_SIZE (INDICES_OFFSET + sizeof(uint32_t) * DWARF_MAX_CLUSTER_LIGHT_INDICES)
+
 namespace Dwarf
 {
+    static_assert(sizeof(ClusterGrid) % 16 == 0 && sizeof(LightEntry) % 16 == 0, "ClusterGrid and LightEntry must keep the std430 offsets of lighting.glsl");
+
     LightManager::LightManager(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties)
-        : _device(device), _mappedData(nullptr), _light(0.0, 0.0, 0.0, Color(1.0f, 1.0f, 1.0f), 5.0), _speed(2.0f * 3.14f / 2.0f), _angle(0.0f)
+        : _device(device), _speed(2.0f * 3.14f / 2.0f), _angle(0.0f), _clusterLights(DWARF_CLUSTER_COUNT), _overflowed(false), _mappedData(nullptr)
     {
+        // Reaches as far as the single light of the former distance falloff
+        this->_lights.push_back(Light(0.0, 0.0, 0.0, Color(1.0f, 1.0f, 1.0f), 20.0));
         this->buildDescriptorSet(memProperties);
     }
 
@@ -12,32 +25,126 @@ namespace Dwarf
     {
         this->_device.unmapMemory(this->_bufferMemory);
         this->_device.freeMemory(this->_bufferMemory, CUSTOM_ALLOCATOR);
-        this->_device.destroyBuffer(this->_uniformBuffer, CUSTOM_ALLOCATOR);
+        this->_device.destroyBuffer(this->_storageBuffer, CUSTOM_ALLOCATOR);
     }
 
     void LightManager::buildDescriptorSet(const vk::PhysicalDeviceMemoryProperties &memProperties)
     {
-        vk::BufferCreateInfo bufferInfo(vk::BufferCreateFlags(), sizeof(LightUniformBuffer), vk::BufferUsageFlagBits::eUniformBuffer);
-        this->_uniformBuffer = this->_device.createBuffer(bufferInfo, CUSTOM_ALLOCATOR);
-        vk::MemoryRequirements memRequirements = this->_device.getBufferMemoryRequirements(this->_uniformBuffer);
-        vk::MemoryAllocateInfo memAllocInfo(memRequirements.size, Tools::getMemoryType(memProperties, memRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
-        this->_bufferMemory = this->_device.allocateMemory(memAllocInfo, CUSTOM_ALLOCATOR);
-        this->_mappedData = this->_device.mapMemory(this->_bufferMemory, 0, sizeof(LightUniformBuffer));
-        memcpy(this->_mappedData, &this->_light.getUniformBuffer(), sizeof(LightUniformBuffer));
-        this->_device.bindBufferMemory(this->_uniformBuffer, this->_bufferMemory, 0);
-        this->_descriptorBufferInfo = vk::DescriptorBufferInfo(this->_uniformBuffer, 0, sizeof(LightUniformBuffer));
+        Tools::createBuffer(this->_device, memProperties, LIGHTING_BUFFER_SIZE, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_storageBuffer, this->_bufferMemory);
+        this->_mappedData = this->_device.mapMemory(this->_bufferMemory, 0, LIGHTING_BUFFER_SIZE);
+        // Empty grid until the first update, nothing is lit
+        memset(this->_mappedData, 0, LIGHTING_BUFFER_SIZE);
+        this->_descriptorBufferInfo = vk::DescriptorBufferInfo(this->_storageBuffer, 0, LIGHTING_BUFFER_SIZE);
+    }
+
+    uint32_t LightManager::addLight(const Light &light)
+    {
+        if (this->_lights.size() >= DWARF_MAX_LIGHTS)
+            Tools::exitOnError("LightManager: more than " + std::to_string(DWARF_MAX_LIGHTS) + " lights");
+        this->_lights.push_back(light);
+        return (static_cast<uint32_t>(this->_lights.size() - 1));
+    }
+
+    Light &LightManager::getLight(uint32_t index)
+    {
+        return (this->_lights.at(index));
+    }
+
+    uint32_t LightManager::getLightCount() const
+    {
+        return (static_cast<uint32_t>(this->_lights.size()));
     }
 
     void LightManager::updateLightPos(float elapsedTime)
     {
         this->_angle += this->_speed * elapsedTime;
         glm::dvec3 tmp(cos(this->_angle) * 8.0, 0.0, sin(this->_angle) * 8.0);
-        this->_light.setPosition(tmp);
-        memcpy(this->_mappedData, &this->_light.getUniformBuffer(), sizeof(LightUniformBuffer));
+        this->_lights.front().setPosition(tmp);
+    }
+
+    void LightManager::updateClusters(const glm::mat4 &view, const glm::mat4 &projection, float zNear, float zFar, const vk::Extent2D &extent)
+    {
+        ClusterGrid *grid = static_cast<ClusterGrid *>(this->_mappedData);
+        LightEntry *lights = reinterpret_cast<LightEntry *>(static_cast<unsigned char *>(this->_mappedData) + LIGHTS_OFFSET);
+        glm::uvec2 *clusters = reinterpret_cast<glm::uvec2 *>(static_cast<unsigned char *>(this->_mappedData) + CLUSTERS_OFFSET);
+        uint32_t *indices = reinterpret_cast<uint32_t *>(static_cast<unsigned char *>(this->_mappedData) + INDICES_OFFSET);
+        float logDepthRatio = std::log2(zFar / zNear);
+        glm::vec3 center;
+        glm::vec4 corner;
+        glm::vec2 screenMin;
+        glm::vec2 screenMax;
+        float range;
+        float depthMin;
+        float depthMax;
+        uint32_t offset = 0;
+        uint32_t count;
+
+        grid->view = view;
+        grid->clusterScale = glm::vec4(DWARF_CLUSTER_X / static_cast<float>(extent.width), DWARF_CLUSTER_Y / static_cast<float>(extent.height), DWARF_CLUSTER_Z / logDepthRatio, -DWARF_CLUSTER_Z * std::log2(zNear) / logDepthRatio);
+        grid->clusterCount = glm::uvec4(DWARF_CLUSTER_X, DWARF_CLUSTER_Y, DWARF_CLUSTER_Z, static_cast<uint32_t>(this->_lights.size()));
+        for (auto &clusterLights : this->_clusterLights)
+            clusterLights.clear();
+        for (uint32_t light = 0; light < this->_lights.size(); ++light)
+        {
+            const LightEntry &entry = this->_lights.at(light).getEntry();
+            lights[light] = entry;
+            center = glm::vec3(view * glm::vec4(glm::vec3(entry.position), 1.0f));
+            range = entry.position.w;
+            // The view looks down -z, its depths are positive
+            depthMin = std::max(-center.z - range, zNear);
+            depthMax = std::min(-center.z + range, zFar);
+            if (depthMin > depthMax)
+                continue;
+            // Screen bounds of the view space box of the light, in front of the near plane they hold its projection
+            screenMin = glm::vec2(1.0f);
+            screenMax = glm::vec2(-1.0f);
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                corner = projection * glm::vec4(center.x + (i & 1 ? range : -range), center.y + (i & 2 ? range : -range), i & 4 ? -depthMax : -depthMin, 1.0f);
+                screenMin = glm::min(screenMin, glm::vec2(corner) / corner.w);
+                screenMax = glm::max(screenMax, glm::vec2(corner) / corner.w);
+            }
+            screenMin = glm::clamp(screenMin * 0.5f + 0.5f, 0.0f, 1.0f);
+            screenMax = glm::clamp(screenMax * 0.5f + 0.5f, 0.0f, 1.0f);
+            if (screenMin.x >= screenMax.x || screenMin.y >= screenMax.y)
+                continue;
+            uint32_t xLast = std::min(static_cast<uint32_t>(screenMax.x * DWARF_CLUSTER_X), static_cast<uint32_t>(DWARF_CLUSTER_X - 1));
+            uint32_t yLast = std::min(static_cast<uint32_t>(screenMax.y * DWARF_CLUSTER_Y), static_cast<uint32_t>(DWARF_CLUSTER_Y - 1));
+            uint32_t zLast = LightManager::getSlice(depthMax, grid->clusterScale);
+            for (uint32_t z = LightManager::getSlice(depthMin, grid->clusterScale); z <= zLast; ++z)
+            {
+                for (uint32_t y = static_cast<uint32_t>(screenMin.y * DWARF_CLUSTER_Y); y <= yLast; ++y)
+                {
+                    for (uint32_t x = static_cast<uint32_t>(screenMin.x * DWARF_CLUSTER_X); x <= xLast; ++x)
+                        this->_clusterLights.at((z * DWARF_CLUSTER_Y + y) * DWARF_CLUSTER_X + x).push_back(light);
+                }
+            }
+        }
+        for (uint32_t cluster = 0; cluster < DWARF_CLUSTER_COUNT; ++cluster)
+        {
+            const std::vector<uint32_t> &clusterLights = this->_clusterLights.at(cluster);
+            count = std::min(static_cast<uint32_t>(clusterLights.size()), static_cast<uint32_t>(DWARF_MAX_CLUSTER_LIGHT_INDICES) - offset);
+            if (count < clusterLights.size() && !this->_overflowed)
+            {
+                LOG(WARNING) << "LightManager: more than " << DWARF_MAX_CLUSTER_LIGHT_INDICES << " light indices, the lights of the last clusters are dropped";
+                this->_overflowed = true;
+            }
+            clusters[cluster] = glm::uvec2(offset, count);
+            if (count > 0)
+                memcpy(indices + offset, clusterLights.data(), sizeof(uint32_t) * count);
+            offset += count;
+        }
     }
 
     const vk::DescriptorBufferInfo &LightManager::getDescriptorBufferInfo() const
     {
         return (this->_descriptorBufferInfo);
     }
+
+    uint32_t LightManager::getSlice(float depth, const glm::vec4 &clusterScale)
+    {
+        float slice = std::floor(std::log2(depth) * clusterScale.z + clusterScale.w);
+
+        return (static_cast<uint32_t>(glm::clamp(slice, 0.0f, static_cast<float>(DWARF_CLUSTER_Z - 1))));
+    }
 }
@@ -1,9 +1,13 @@
 #include "Material.h"
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace Dwarf
 {
-	Material::Material(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::Pipeline &pipeline, const vk::PipelineLayout &pipelineLayout, Material::ID id, const std::string &name)
-		: _device(device), _graphicsQueue(graphicsQueue), _pipeline(pipeline), _pipelineLayout(pipelineLayout), _id(id), _name(name)
+	Material::Material(const vk::Device &device, const vk::Queue &graphicsQueue, const MaterialPipeline &pipeline, const vk::Pipeline &fallbackPipeline, const vk::PipelineLayout &pipelineLayout, TextureManager &textureManager, Material::ID id, const std::string &name)
+		: _device(device), _graphicsQueue(graphicsQueue), _pipeline(pipeline), _fallbackPipeline(fallbackPipeline), _pipelineLayout(pipelineLayout), _textureManager(textureManager), _materialTable(nullptr), _tableIndex(0), _diffuseTexture({ -1, -1, 0 }), _id(id), _name(name), _hash(0), _hashValid(false)
 	{
         this->init();
 	}
@@ -11,27 +15,71 @@ namespace Dwarf
 	Material::~Material()
 	{
         for (auto &texture : this->_textures)
-            delete (texture.second);
+            this->_textureManager.release(texture);
 	}
 
     void Material::buildDescriptorSet(const vk::Buffer &buffer, const vk::DeviceSize &uniformBufferOffset, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::DescriptorBufferInfo &lightBufferInfo)
     {
         //vk::DescriptorImageInfo &imageInfo = this->_texture->createTexture(memProperties, descriptorPool, descriptorSetLayout);
+        if (this->_materialTable)
+        {
+            // Shared by several submeshes, the texture is only loaded by the first one
+            if (this->_diffuseTexture.texture < 0)
+                this->_diffuseTexture = this->hasDiffuseTexture() ? this->_materialTable->addTexture(*this->_textures[TEXTURE_DIFFUSE], memProperties) : TableTexture{ 0, -1, 0 };
+            this->_materialTable->setMaterial(this->_tableIndex, this->_uniformBuffer, this->_diffuseTexture);
+            this->_materialTable->setLight(lightBufferInfo);
+            return;
+        }
 
         vk::DescriptorBufferInfo bufferInfo(buffer, uniformBufferOffset, sizeof(MaterialUniformBuffer));
-        std::vector<vk::WriteDescriptorSet> descriptorWrites = { vk::WriteDescriptorSet(this->_descriptorSet, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo), vk::WriteDescriptorSet(this->_descriptorSet, 2, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &lightBufferInfo) };
+        std::vector<vk::WriteDescriptorSet> descriptorWrites = { vk::WriteDescriptorSet(this->_descriptorSet, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &bufferInfo), vk::WriteDescriptorSet(this->_descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &lightBufferInfo) };
         for (auto &texture : this->_textures)
-            descriptorWrites.push_back(vk::WriteDescriptorSet(this->_descriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &texture.second->createTexture(memProperties)));
+        {
+            if (texture)
+            {
+                descriptorWrites.push_back(vk::WriteDescriptorSet(this->_descriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &texture->createTexture(memProperties)));
+                // Rewritten by the texture when its streamed levels change
+                texture->addDescriptor(this->_descriptorSet, 1, 0);
+            }
+        }
         this->_device.updateDescriptorSets(descriptorWrites, nullptr);
     }
 
 	bool Material::isSame(const Material &material) const
 	{
-		if (this->_id != material._id || this->_values.size() != material._values.size() || !std::equal(this->_values.begin(), this->_values.end(), material._values.begin()) || this->_textures.size() != material._textures.size() || !std::equal(this->_textures.begin(), this->_textures.end(), material._textures.begin()))
+		// The hash only buckets, a collision must not merge two different materials
+		if (this->getHash() != material.getHash())
+			return (false);
+		if (std::memcmp(&this->_uniformBuffer, &material._uniformBuffer, sizeof(this->_uniformBuffer)) != 0
+			|| std::memcmp(&this->_pbrParameters, &material._pbrParameters, sizeof(this->_pbrParameters)) != 0)
 			return (false);
+		for (uint32_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+		{
+			if (this->_textures[slot] != material._textures[slot])
+				return (false);
+		}
 		return (true);
 	}
 
+    uint64_t Material::getHash() const
+    {
+        if (this->_hashValid)
+            return (this->_hash);
+        // Both structures are tightly packed 32 bits fields, their bytes are the content
+        this->_hash = Tools::hash64(&this->_uniformBuffer, sizeof(this->_uniformBuffer));
+        this->_hash = Tools::hash64(&this->_pbrParameters, sizeof(this->_pbrParameters), this->_hash);
+        // Textures are interned by resolved path in the TextureManager, the same file is the same pointer
+        for (uint32_t slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+        {
+            if (!this->_textures[slot])
+                continue;
+            this->_hash = Tools::hash64(&slot, sizeof(slot), this->_hash);
+            this->_hash = Tools::hash64(&this->_textures[slot], sizeof(this->_textures[slot]), this->_hash);
+        }
+        this->_hashValid = true;
+        return (this->_hash);
+    }
+
     Material::ID Material::getID() const
     {
         return (this->_id);
@@ -44,7 +92,14 @@ namespace Dwarf
 
     const vk::Pipeline &Material::getPipeline() const
     {
-        return (this->_pipeline);
+        if (!this->isPipelineReady())
+            return (this->_fallbackPipeline);
+        return (this->_pipeline.pipeline);
+    }
+
+    bool Material::isPipelineReady() const
+    {
+        return (this->_pipeline.ready.load(std::memory_order_acquire));
     }
 
     const vk::PipelineLayout &Material::getPipelineLayout() const
@@ -64,14 +119,12 @@ namespace Dwarf
 
     bool Material::hasDiffuseTexture() const
     {
-        return (this->_textures.find(DIFFUSE) != this->_textures.end());
+        return (this->_textures[TEXTURE_DIFFUSE] != nullptr);
     }
 
-    void Material::setCommandPool(vk::CommandPool *commandPool)
+    const std::array<Texture *, TEXTURE_SLOT_COUNT> &Material::getTextures() const
     {
-        this->_commandPool = commandPool;
-        for (auto &texture : this->_textures)
-            texture.second->setCommandPool(commandPool);
+        return (this->_textures);
     }
 
     void Material::setDescriptorSet(vk::DescriptorSet descriptorSet)
@@ -79,209 +132,206 @@ namespace Dwarf
         this->_descriptorSet = descriptorSet;
     }
 
+    void Material::setMaterialTable(MaterialTable *materialTable, uint32_t tableIndex)
+    {
+        this->_materialTable = materialTable;
+        this->_tableIndex = tableIndex;
+        this->_descriptorSet = materialTable->getDescriptorSet();
+        this->update();
+    }
+
+    bool Material::isBindless() const
+    {
+        return (this->_materialTable != nullptr);
+    }
+
+    uint32_t Material::getTableIndex() const
+    {
+        return (this->_tableIndex);
+    }
+
 	void Material::setAmbient(Color value)
 	{
-		this->_values[AMBIENT].value.c = value;
         this->_uniformBuffer.Ka = value.getColor();
+        this->update();
 	}
 
 	void Material::setDiffuse(Color value)
 	{
-		this->_values[DIFFUSE].value.c = value;
         this->_uniformBuffer.Kd = value.getColor();
+        this->update();
 	}
 
 	void Material::setSpecular(Color value)
 	{
-		this->_values[SPECULAR].value.c = value;
         this->_uniformBuffer.Ks = value.getColor();
+        this->update();
 	}
 
 	void Material::setTransmittance(Color value)
 	{
-		this->_values[TRANSMITTANCE].value.c = value;
         this->_uniformBuffer.Tf = value.getColor();
+        this->update();
 	}
 
 	void Material::setEmission(Color value)
 	{
-		this->_values[EMISSION].value.c = value;
         this->_uniformBuffer.Ke = value.getColor();
+        this->update();
 	}
 
 	void Material::setShininess(float value)
 	{
-		this->_values[SHININESS].value.f = value;
         this->_uniformBuffer.Ns = value;
+        this->update();
 	}
 
 	void Material::setIor(float value)
 	{
-		this->_values[IOR].value.f = value;
         this->_uniformBuffer.Ni = value;
+        this->update();
 	}
 
 	void Material::setDissolve(float value)
 	{
-		this->_values[DISSOLVE].value.f = value;
         this->_uniformBuffer.d = value;
+        this->update();
 	}
 
 	void Material::setIllum(int value)
 	{
-		this->_values[ILLUM].value.i = value;
         this->_uniformBuffer.illum = value;
+        this->update();
 	}
 
 	void Material::setRoughness(float value)
 	{
-		this->_values[ROUGHNESS].value.f = value;
+        this->_pbrParameters.roughness = value;
+        this->update();
 	}
 
 	void Material::setMetallic(float value)
 	{
-		this->_values[METALLIC].value.f = value;
+        this->_pbrParameters.metallic = value;
+        this->update();
 	}
 
 	void Material::setSheen(float value)
 	{
-		this->_values[SHEEN].value.f = value;
+        this->_pbrParameters.sheen = value;
+        this->update();
 	}
 
 	void Material::setClearcoatThickness(float value)
 	{
-		this->_values[CLEARCOAT_THICKNESS].value.f = value;
+        this->_pbrParameters.clearcoatThickness = value;
+        this->update();
 	}
 
 	void Material::setClearcoatRoughness(float value)
 	{
-		this->_values[CLEARCOAT_ROUGHNESS].value.f = value;
+        this->_pbrParameters.clearcoatRoughness = value;
+        this->update();
 	}
 
 	void Material::setAnisotropy(float value)
 	{
-		this->_values[ANISOTROPY].value.f = value;
+        this->_pbrParameters.anisotropy = value;
+        this->update();
 	}
 
 	void Material::setAnisotropyRotation(float value)
 	{
-		this->_values[ANISOTROPY_ROTATION].value.f = value;
+        this->_pbrParameters.anisotropyRotation = value;
+        this->update();
 	}
 
 	void Material::createAmbientTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(AMBIENT) != this->_textures.end())
-			delete (this->_textures.at(AMBIENT));
-		this->_textures[AMBIENT] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_AMBIENT, textureName);
 	}
 
 	void Material::createDiffuseTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(DIFFUSE) != this->_textures.end())
-			delete (this->_textures.at(DIFFUSE));
-		this->_textures[DIFFUSE] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_DIFFUSE, textureName);
 	}
 
 	void Material::createSpecularTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(SPECULAR) != this->_textures.end())
-			delete (this->_textures.at(SPECULAR));
-		this->_textures[SPECULAR] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_SPECULAR, textureName);
 	}
 
 	void Material::createSpecularHighlightTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(SPECULAR_HIGHLIGHT) != this->_textures.end())
-			delete (this->_textures.at(SPECULAR_HIGHLIGHT));
-		this->_textures[SPECULAR_HIGHLIGHT] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_SPECULAR_HIGHLIGHT, textureName);
 	}
 
 	void Material::createBumpTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(BUMP) != this->_textures.end())
-			delete (this->_textures.at(BUMP));
-		this->_textures[BUMP] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_BUMP, textureName);
 	}
 
 	void Material::createDisplacementTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(DISPLACEMENT) != this->_textures.end())
-			delete (this->_textures.at(DISPLACEMENT));
-		this->_textures[DISPLACEMENT] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_DISPLACEMENT, textureName);
 	}
 
 	void Material::createAlphaTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(ALPHA) != this->_textures.end())
-			delete (this->_textures.at(ALPHA));
-		this->_textures[ALPHA] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_ALPHA, textureName);
 	}
 
 	void Material::createRoughnessTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(ROUGHNESS) != this->_textures.end())
-			delete (this->_textures.at(ROUGHNESS));
-		this->_textures[ROUGHNESS] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_ROUGHNESS, textureName);
 	}
 
 	void Material::createMetallicTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(METALLIC) != this->_textures.end())
-			delete (this->_textures.at(METALLIC));
-		this->_textures[METALLIC] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_METALLIC, textureName);
 	}
 
 	void Material::createSheenTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(SHEEN) != this->_textures.end())
-			delete (this->_textures.at(SHEEN));
-		this->_textures[SHEEN] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_SHEEN, textureName);
 	}
 
 	void Material::createEmissiveTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(EMISSIVE) != this->_textures.end())
-			delete (this->_textures.at(EMISSIVE));
-		this->_textures[EMISSIVE] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_EMISSIVE, textureName);
 	}
 
 	void Material::createNormalTexture(const std::string &textureName)
 	{
-		if (this->_textures.find(NORMAL) != this->_textures.end())
-			delete (this->_textures.at(NORMAL));
-		this->_textures[NORMAL] = new Texture(this->_device, this->_commandPool, this->_graphicsQueue, textureName);
+        this->createTexture(TEXTURE_NORMAL, textureName);
 	}
 
 	void Material::init()
 	{
-		this->_values[AMBIENT] = Value(ValueType::COLOR, Color());
-		this->_values[DIFFUSE] = Value(ValueType::COLOR, Color());
-		this->_values[SPECULAR] = Value(ValueType::COLOR, Color());
-		this->_values[TRANSMITTANCE] = Value(ValueType::COLOR, Color());
-		this->_values[EMISSION] = Value(ValueType::COLOR, Color());
-		this->_values[SHININESS] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[IOR] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[DISSOLVE] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[ILLUM] = Value(ValueType::INT, 0);
-		this->_values[ROUGHNESS] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[METALLIC] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[SHEEN] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[CLEARCOAT_THICKNESS] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[CLEARCOAT_ROUGHNESS] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[ANISOTROPY] = Value(ValueType::FLOAT, 1.0f);
-		this->_values[ANISOTROPY_ROTATION] = Value(ValueType::FLOAT, 1.0f);
-	}
-
-	bool operator==(const Value &lhs, const Value &rhs)
-	{
-		return (lhs.isSame(rhs));
-	}
+        glm::vec4 color = Color().getColor();
 
-	bool operator!=(const Value &lhs, const Value &rhs)
-	{
-		return (!lhs.isSame(rhs));
+        this->_uniformBuffer = { color, color, color, color, color, 1.0f, 1.0f, 1.0f, 0 };
+        this->_pbrParameters = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+        this->_textures.fill(nullptr);
 	}
 
+    void Material::createTexture(TextureSlot slot, const std::string &textureName)
+    {
+        this->_textureManager.release(this->_textures[slot]);
+        this->_textures[slot] = this->_textureManager.acquire(textureName);
+        if (slot == TEXTURE_DIFFUSE)
+            this->_diffuseTexture = { -1, -1, 0 };
+        this->update();
+    }
+
+    void Material::update()
+    {
+        this->_hashValid = false;
+        // The table is mapped, the entry is written in place
+        if (this->_materialTable)
+            this->_materialTable->setMaterial(this->_tableIndex, this->_uniformBuffer, this->_diffuseTexture.texture < 0 ? TableTexture{ 0, -1, 0 } : this->_diffuseTexture);
+    }
+
 	bool operator==(const Material &lhs, const Material &rhs)
 	{
 		return (lhs.isSame(rhs));
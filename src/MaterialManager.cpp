@@ -1,24 +1,32 @@
 #include "MaterialManager.h"
 #include "Mesh.h"
 
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
 namespace Dwarf
 {
-	MaterialManager::MaterialManager(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::RenderPass &renderPass, const vk::Extent2D &swapChainExtent)
-        : _device(device), _graphicsQueue(graphicsQueue), _renderPass(renderPass), _swapChainExtent(swapChainExtent), _lastID(0)
+	MaterialManager::MaterialManager(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::RenderPass &renderPass, PipelineCache &pipelineCache, ShaderLibrary &shaderLibrary, DescriptorAllocator &descriptorAllocator, TextureManager &textureManager, SamplerCache &samplerCache, uint32_t compileThreadCount, MaterialTable *materialTable)
+        : _device(device), _graphicsQueue(graphicsQueue), _renderPass(renderPass), _pipelineCache(pipelineCache), _shaderLibrary(shaderLibrary), _descriptorAllocator(descriptorAllocator), _textureManager(textureManager), _samplerCache(samplerCache), _materialTable(materialTable), _lastID(0), _duplicateCount(0), _compileThreadCount(std::max(compileThreadCount, 1u)), _nextCompileThread(0)
 	{
+        this->_compilePool.setThreadCount(this->_compileThreadCount);
         this->createDescriptorSetLayout();
         this->createPipelineLayout();
+        MaterialPipeline &fallback = this->_pipelines[this->getPipelineState(false, false)];
+        this->createPipeline(this->getPipelineState(false, false), fallback);
+        this->_fallbackPipeline = &fallback.pipeline;
         this->createMaterial("default", false);
 	}
 
 	MaterialManager::~MaterialManager()
 	{
+        this->waitPipelines();
         for (auto &material : this->_materials)
             delete (material.second);
         for (const auto &pipeline : this->_pipelines)
-            this->_device.destroyPipeline(pipeline.second, CUSTOM_ALLOCATOR);
+            this->_device.destroyPipeline(pipeline.second.pipeline, CUSTOM_ALLOCATOR);
         this->_device.destroyDescriptorSetLayout(this->_descriptorSetLayout, CUSTOM_ALLOCATOR);
-        this->_device.destroyDescriptorPool(this->_descriptorPool, CUSTOM_ALLOCATOR);
         this->_device.destroyPipelineLayout(this->_pipelineLayout, CUSTOM_ALLOCATOR);
     }
 
@@ -46,42 +54,59 @@ namespace Dwarf
         return (nullptr);
     }
 
-    Material *MaterialManager::createMaterial(const std::string &materialName, bool diffuseTexture)
+    Material *MaterialManager::createMaterial(const std::string &materialName, bool diffuseTexture, bool alphaTest)
     {
         if (this->_materialsNames.find(materialName) != this->_materialsNames.end())
             return (this->_materials.at(this->_materialsNames.at(materialName)));
         else
         {
             ++this->_lastID;
-            this->createMaterialPipeline(this->_lastID, diffuseTexture);
-            this->_materials[this->_lastID] = new Material(this->_device, this->_graphicsQueue, this->_pipelines.at(this->_lastID), this->_pipelineLayout, this->_lastID, materialName);
+            const MaterialPipeline &pipeline = this->getPipeline(this->getPipelineState(diffuseTexture, alphaTest));
+            this->_materials[this->_lastID] = new Material(this->_device, this->_graphicsQueue, pipeline, *this->_fallbackPipeline, this->_pipelineLayout, this->_textureManager, this->_lastID, materialName);
+            if (this->_materialTable)
+                this->_materials.at(this->_lastID)->setMaterialTable(this->_materialTable, this->_materialTable->addMaterial());
+            else
+                this->_materials.at(this->_lastID)->setDescriptorSet(this->_descriptorAllocator.allocate(this->_descriptorSetLayout));
             this->_materialsNames[materialName] = this->_lastID;
             return (this->_materials.at(this->_lastID));
         }
     }
 
-    void MaterialManager::createDescriptorPool()
+    Material *MaterialManager::internMaterial(Material *material)
     {
-        uint32_t descriptorCount = static_cast<uint32_t>(this->_materials.size()) * 2;
-        std::vector<vk::DescriptorPoolSize> poolSizes = { vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, descriptorCount), vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, descriptorCount) };
-        vk::DescriptorPoolCreateInfo poolInfo(vk::DescriptorPoolCreateFlags(), descriptorCount, static_cast<uint32_t>(poolSizes.size()), poolSizes.data());
-        this->_descriptorPool = this->_device.createDescriptorPool(poolInfo, CUSTOM_ALLOCATOR);
-        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts(this->_materials.size(), this->_descriptorSetLayout);
-        vk::DescriptorSetAllocateInfo allocInfo(this->_descriptorPool, static_cast<uint32_t>(this->_materials.size()), descriptorSetLayouts.data());
-        std::vector<vk::DescriptorSet> descriptorSets = this->_device.allocateDescriptorSets(allocInfo);
-        uint32_t i = 0;
-        for (const auto &material : this->_materials)
+        auto interned = this->_materialsHashes.find(material->getHash());
+
+        // The interned material may have been modified since, its hash is checked again
+        if (interned == this->_materialsHashes.end() || interned->second == material->getID() || !this->exist(interned->second) || !this->isSame(interned->second, material)
+            || this->_internedMaterials.count(material->getID()) != 0)
         {
-            this->_descriptorSets[material.first] = descriptorSets.at(i);
-            material.second->setDescriptorSet(this->_descriptorSets.at(material.first));
-            ++i;
+            this->_materialsHashes[material->getHash()] = material->getID();
+            this->_internedMaterials.insert(material->getID());
+            return (material);
         }
+        Material *existing = this->_materials.at(interned->second);
+        this->_materialsNames[material->getName()] = existing->getID();
+        this->destroyMaterial(material);
+        ++this->_duplicateCount;
+        return (existing);
+    }
+
+    void MaterialManager::logStatistics() const
+    {
+        LOG(INFO) << "MaterialManager: " << this->_pipelines.size() << " pipelines shared by " << this->_materials.size() << (this->_materialTable ? " bindless materials, " : " materials, ") << this->_duplicateCount << " duplicates interned";
     }
 
     void MaterialManager::recreatePipelines()
     {
-        for (const auto &pipeline : this->_pipelines)
-            this->createMaterialPipeline(pipeline.first, this->_materials.at(pipeline.first)->hasDiffuseTexture());
+        this->waitPipelines();
+        for (auto &pipeline : this->_pipelines)
+            this->queuePipeline(pipeline.first, pipeline.second);
+        this->waitPipelines();
+    }
+
+    void MaterialManager::waitPipelines()
+    {
+        this->_compilePool.wait();
     }
 
     void MaterialManager::createDescriptorSetLayout()
@@ -89,60 +114,85 @@ namespace Dwarf
         std::vector<vk::DescriptorSetLayoutBinding> bindings =
         {
             vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment),
-            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment),
-            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex)
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment, this->_samplerCache.getImmutableSampler(Texture::getSamplerInfo())),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment)
         };
         vk::DescriptorSetLayoutCreateInfo layoutInfo(vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data());
         if (this->_descriptorSetLayout)
             this->_device.destroyDescriptorSetLayout(this->_descriptorSetLayout, CUSTOM_ALLOCATOR);
         this->_descriptorSetLayout = this->_device.createDescriptorSetLayout(layoutInfo, CUSTOM_ALLOCATOR);
+        this->_descriptorAllocator.addLayout(this->_descriptorSetLayout, bindings);
     }
 
     void MaterialManager::createPipelineLayout()
     {
-        vk::PushConstantRange pushConstantInfo(vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4) * 2);
-        vk::PipelineLayoutCreateInfo pipelineLayoutInfo(vk::PipelineLayoutCreateFlags(), 1, &this->_descriptorSetLayout, 1, &pushConstantInfo);
+        // The fragment stage reads the table index of the material after the matrices
+        std::array<vk::PushConstantRange, 2> pushConstantInfos = { vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4) * 2), vk::PushConstantRange(vk::ShaderStageFlagBits::eFragment, sizeof(glm::mat4) * 2, sizeof(uint32_t)) };
+        const vk::DescriptorSetLayout &descriptorSetLayout = this->_materialTable ? this->_materialTable->getDescriptorSetLayout() : this->_descriptorSetLayout;
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo(vk::PipelineLayoutCreateFlags(), 1, &descriptorSetLayout, this->_materialTable ? 2 : 1, pushConstantInfos.data());
         if (this->_pipelineLayout)
             this->_device.destroyPipelineLayout(this->_pipelineLayout, CUSTOM_ALLOCATOR);
         this->_pipelineLayout = this->_device.createPipelineLayout(pipelineLayoutInfo, CUSTOM_ALLOCATOR);
     }
 
-    void MaterialManager::createMaterialPipeline(const Material::ID &materialID, bool diffuseTexture)
+    PipelineState MaterialManager::getPipelineState(bool diffuseTexture, bool alphaTest) const
     {
-        std::vector<char> vertShaderCode;
-        std::vector<char> fragShaderCode;
-        if (diffuseTexture)
-        {
-            vertShaderCode = Tools::readFile("shaders/materialTexture.vert.spv");
-            fragShaderCode = Tools::readFile("shaders/materialTexture.frag.spv");
-        }
-        else
+        PipelineState state;
+        state.vertexShader = "shaders/material.vert.spv";
+        state.fragmentShader = this->_materialTable ? "shaders/bindless.frag.spv" : "shaders/material.frag.spv";
+        state.textured = diffuseTexture ? VK_TRUE : VK_FALSE;
+        state.alphaTest = alphaTest ? VK_TRUE : VK_FALSE;
+        return (state);
+    }
+
+    const MaterialPipeline &MaterialManager::getPipeline(const PipelineState &state)
+    {
+        auto result = this->_pipelines.emplace(std::piecewise_construct, std::forward_as_tuple(state), std::forward_as_tuple());
+        if (result.second)
+            this->queuePipeline(result.first->first, result.first->second);
+        return (result.first->second);
+    }
+
+    void MaterialManager::queuePipeline(const PipelineState &state, MaterialPipeline &pipeline)
+    {
+        // Loaded on the calling thread, the workers only find them in the library
+        this->_shaderLibrary.getModule(state.vertexShader);
+        this->_shaderLibrary.getModule(state.fragmentShader);
+        this->_compilePool.addJobThread(this->_nextCompileThread, std::bind(&MaterialManager::createPipeline, this, std::cref(state), std::ref(pipeline)));
+        this->_nextCompileThread = (this->_nextCompileThread + 1) % this->_compileThreadCount;
+    }
+
+    // Runs on the compile workers: only reads the manager state that waitPipelines protects
+    void MaterialManager::createPipeline(const PipelineState &state, MaterialPipeline &pipeline)
+    {
+        // The texture counts only exist in bindless.frag, material.frag ignores them
+        std::array<uint32_t, 4> specializationData = { state.textured, state.alphaTest, this->_materialTable ? this->_materialTable->getTextureCapacity() : 1, this->_materialTable ? this->_materialTable->getTextureArrayCapacity() : 1 };
+        std::array<vk::SpecializationMapEntry, 4> specializationEntries =
         {
-            vertShaderCode = Tools::readFile("shaders/material.vert.spv");
-            fragShaderCode = Tools::readFile("shaders/material.frag.spv");
-        }
-        vk::ShaderModule vertShaderModule = this->_device.createShaderModule(vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), vertShaderCode.size(), reinterpret_cast<uint32_t *>(vertShaderCode.data())), CUSTOM_ALLOCATOR);
-        vk::ShaderModule fragShaderModule = this->_device.createShaderModule(vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), fragShaderCode.size(), reinterpret_cast<uint32_t *>(fragShaderCode.data())), CUSTOM_ALLOCATOR);
-        vk::PipelineShaderStageCreateInfo shaderStages[] = { vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, vertShaderModule, "main"), vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, fragShaderModule, "main") };
-        vk::VertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-        std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
-        vk::PipelineVertexInputStateCreateInfo vertexInputInfo(vk::PipelineVertexInputStateCreateFlags(), 1, &bindingDescription, static_cast<uint32_t>(attributeDescriptions.size()), attributeDescriptions.data());
-        vk::PipelineInputAssemblyStateCreateInfo inputAssembly(vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList, VK_FALSE);
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(this->_swapChainExtent.width), static_cast<float>(this->_swapChainExtent.height), 0.0f, 1.0f);
-        vk::Rect2D scissor(vk::Offset2D(), this->_swapChainExtent);
-        vk::PipelineViewportStateCreateInfo viewportState(vk::PipelineViewportStateCreateFlags(), 1, &viewport, 1, &scissor);
-        vk::PipelineRasterizationStateCreateInfo rasterizer(vk::PipelineRasterizationStateCreateFlags(), VK_FALSE, VK_FALSE, vk::PolygonMode::eFill, vk::CullModeFlagBits::eFront, vk::FrontFace::eCounterClockwise, VK_FALSE, 0.0f, 0.0f, 0.0f, 1.0f);
+            vk::SpecializationMapEntry(0, 0, sizeof(vk::Bool32)),
+            vk::SpecializationMapEntry(1, sizeof(vk::Bool32), sizeof(vk::Bool32)),
+            vk::SpecializationMapEntry(2, sizeof(vk::Bool32) * 2, sizeof(uint32_t)),
+            vk::SpecializationMapEntry(3, sizeof(vk::Bool32) * 2 + sizeof(uint32_t), sizeof(uint32_t))
+        };
+        vk::SpecializationInfo specializationInfo(static_cast<uint32_t>(specializationEntries.size()), specializationEntries.data(), sizeof(specializationData), specializationData.data());
+        vk::PipelineShaderStageCreateInfo shaderStages[] = { vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, this->_shaderLibrary.getModule(state.vertexShader), "main"), vk::PipelineShaderStageCreateInfo(vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, this->_shaderLibrary.getModule(state.fragmentShader), "main", &specializationInfo) };
+        vk::PipelineVertexInputStateCreateInfo vertexInputInfo(vk::PipelineVertexInputStateCreateFlags(), 1, &state.binding, static_cast<uint32_t>(state.attributes.size()), state.attributes.data());
+        vk::PipelineInputAssemblyStateCreateInfo inputAssembly(vk::PipelineInputAssemblyStateCreateFlags(), state.topology, VK_FALSE);
+        // Set when recording, so that a resize keeps the pipelines
+        vk::PipelineViewportStateCreateInfo viewportState(vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr);
+        std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+        vk::PipelineDynamicStateCreateInfo dynamicState(vk::PipelineDynamicStateCreateFlags(), static_cast<uint32_t>(dynamicStates.size()), dynamicStates.data());
+        vk::PipelineRasterizationStateCreateInfo rasterizer(vk::PipelineRasterizationStateCreateFlags(), VK_FALSE, VK_FALSE, vk::PolygonMode::eFill, state.cullMode, state.frontFace, VK_FALSE, 0.0f, 0.0f, 0.0f, 1.0f);
         vk::PipelineMultisampleStateCreateInfo multisampling(vk::PipelineMultisampleStateCreateFlags(), vk::SampleCountFlagBits::e1, VK_FALSE, 1.0f, nullptr, VK_FALSE, VK_FALSE);
-        vk::PipelineDepthStencilStateCreateInfo depthStencil(vk::PipelineDepthStencilStateCreateFlags(), VK_TRUE, VK_TRUE, vk::CompareOp::eLess);
-        vk::PipelineColorBlendAttachmentState colorBlendAttachment(VK_FALSE, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+        vk::PipelineDepthStencilStateCreateInfo depthStencil(vk::PipelineDepthStencilStateCreateFlags(), state.depthTest, state.depthWrite, state.depthCompare);
+        vk::PipelineColorBlendAttachmentState colorBlendAttachment(state.blend, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
         vk::PipelineColorBlendStateCreateInfo colorBlending(vk::PipelineColorBlendStateCreateFlags(), VK_FALSE, vk::LogicOp::eCopy, 1, &colorBlendAttachment);
-        vk::GraphicsPipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(), 2, shaderStages, &vertexInputInfo, &inputAssembly, nullptr, &viewportState, &rasterizer, &multisampling, &depthStencil, &colorBlending, nullptr, this->_pipelineLayout, this->_renderPass, 0, VK_NULL_HANDLE, -1);
+        vk::GraphicsPipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(), 2, shaderStages, &vertexInputInfo, &inputAssembly, nullptr, &viewportState, &rasterizer, &multisampling, &depthStencil, &colorBlending, &dynamicState, this->_pipelineLayout, this->_renderPass, 0, VK_NULL_HANDLE, -1);
 
-        if (this->_pipelines.find(materialID) != this->_pipelines.end())
-            this->_device.destroyPipeline(this->_pipelines.at(materialID), CUSTOM_ALLOCATOR);
-        this->_pipelines[materialID] = this->_device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineInfo, CUSTOM_ALLOCATOR);
-        this->_device.destroyShaderModule(vertShaderModule, CUSTOM_ALLOCATOR);
-        this->_device.destroyShaderModule(fragShaderModule, CUSTOM_ALLOCATOR);
+        if (pipeline.pipeline)
+            this->_device.destroyPipeline(pipeline.pipeline, CUSTOM_ALLOCATOR);
+        pipeline.pipeline = this->_pipelineCache.createGraphicsPipeline(pipelineInfo);
+        pipeline.ready.store(true, std::memory_order_release);
     }
 
     bool MaterialManager::isSame(const Material::ID &leftMaterialID, Material *rightMaterial) const
@@ -152,4 +202,15 @@ namespace Dwarf
 		return (*this->_materials.at(leftMaterialID) == *rightMaterial);
 	}
 
+    // Only for materials no submesh references yet, their textures are not loaded either
+    void MaterialManager::destroyMaterial(Material *material)
+    {
+        if (this->_materialTable)
+            this->_materialTable->removeMaterial(material->getTableIndex());
+        else
+            this->_descriptorAllocator.free(this->_descriptorSetLayout, material->getDescriptorSet());
+        this->_materials.erase(material->getID());
+        delete (material);
+    }
+
 }
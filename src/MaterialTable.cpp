@@ -0,0 +1,195 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace Dwarf
+{
+    static_assert(sizeof(MaterialEntry) % 16 == 0, "MaterialEntry must keep the std430 array stride of bindless.frag");
+
+    MaterialTable::MaterialTable(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties, const vk::PhysicalDeviceLimits &limits, SamplerCache &samplerCache, bool descriptorIndexing)
+        : _device(device), _samplerCache(samplerCache), _descriptorIndexing(descriptorIndexing), _entries(nullptr), _materialCount(0), _textureCount(0), _arrayCount(0)
+    {
+        uint32_t capacity = std::min({ static_cast<uint32_t>(DWARF_BINDLESS_MAX_TEXTURES + DWARF_BINDLESS_MAX_TEXTURE_ARRAYS), limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+
+        // At least one slot each, the shaders declare both arrays
+        this->_arrayCapacity = std::max(std::min(static_cast<uint32_t>(DWARF_BINDLESS_MAX_TEXTURE_ARRAYS), capacity / 8), 1u);
+        this->_textureCapacity = std::max(capacity - this->_arrayCapacity, 1u);
+        this->createWhiteTexture(graphicsQueue, commandPool, memProperties);
+        this->createBuffer(memProperties);
+        this->createDescriptorSet();
+        LOG(INFO) << "MaterialTable: " << this->_textureCapacity << " texture slots, " << this->_arrayCapacity << " texture array slots, " << (this->_descriptorIndexing ? "descriptor indexing" : "fully bound array");
+    }
+
+    MaterialTable::~MaterialTable()
+    {
+        this->_device.unmapMemory(this->_bufferMemory);
+        this->_device.destroyBuffer(this->_buffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_bufferMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyDescriptorPool(this->_descriptorPool, CUSTOM_ALLOCATOR);
+        this->_device.destroyDescriptorSetLayout(this->_descriptorSetLayout, CUSTOM_ALLOCATOR);
+        this->_device.destroyImageView(this->_whiteArrayView, CUSTOM_ALLOCATOR);
+        this->_device.destroyImageView(this->_whiteImageView, CUSTOM_ALLOCATOR);
+        this->_device.destroyImage(this->_whiteImage, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_whiteImageMemory, CUSTOM_ALLOCATOR);
+    }
+
+    uint32_t MaterialTable::addMaterial()
+    {
+        if (!this->_freeMaterials.empty())
+        {
+            uint32_t index = this->_freeMaterials.back();
+            this->_freeMaterials.pop_back();
+            return (index);
+        }
+        if (this->_materialCount >= DWARF_BINDLESS_MAX_MATERIALS)
+            Tools::exitOnError("MaterialTable: more than " + std::to_string(DWARF_BINDLESS_MAX_MATERIALS) + " materials");
+        return (this->_materialCount++);
+    }
+
+    void MaterialTable::removeMaterial(uint32_t index)
+    {
+        this->_freeMaterials.push_back(index);
+    }
+
+    TableTexture MaterialTable::addTexture(Texture &texture, const vk::PhysicalDeviceMemoryProperties &memProperties)
+    {
+        // Aliases resolve to their source, the streamed image view changes but not the texture
+        const Texture *resolved = texture.getSource() ? texture.getSource() : &texture;
+        TextureArray *textureArray = resolved->getArray();
+        auto slot = this->_textureSlots.find(resolved);
+
+        if (textureArray)
+        {
+            auto arraySlot = this->_arraySlots.find(textureArray);
+            if (arraySlot != this->_arraySlots.end())
+                return (TableTexture{ 0, arraySlot->second, static_cast<int32_t>(resolved->getLayer()) });
+            if (this->_arrayCount < this->_arrayCapacity)
+            {
+                vk::WriteDescriptorSet descriptorWrite(this->_descriptorSet, 3, this->_arrayCount, 1, vk::DescriptorType::eCombinedImageSampler, &textureArray->getImageInfo());
+                this->_device.updateDescriptorSets(descriptorWrite, nullptr);
+                this->_arraySlots[textureArray] = static_cast<int32_t>(this->_arrayCount);
+                return (TableTexture{ 0, static_cast<int32_t>(this->_arrayCount++), static_cast<int32_t>(resolved->getLayer()) });
+            }
+            // Loaded again from its file into an image of its own
+            LOG(WARNING) << "MaterialTable: texture array array full, " << resolved->getName() << " is not sampled from its array";
+        }
+        if (slot != this->_textureSlots.end())
+            return (TableTexture{ slot->second, -1, 0 });
+        if (this->_textureCount >= this->_textureCapacity)
+        {
+            LOG(WARNING) << "MaterialTable: texture array full, the texture is replaced by white";
+            return (TableTexture{ 0, -1, 0 });
+        }
+        vk::WriteDescriptorSet descriptorWrite(this->_descriptorSet, 1, this->_textureCount, 1, vk::DescriptorType::eCombinedImageSampler, &texture.createTexture(memProperties));
+        this->_device.updateDescriptorSets(descriptorWrite, nullptr);
+        texture.addDescriptor(this->_descriptorSet, 1, this->_textureCount);
+        this->_textureSlots[resolved] = static_cast<int32_t>(this->_textureCount);
+        return (TableTexture{ static_cast<int32_t>(this->_textureCount++), -1, 0 });
+    }
+
+    void MaterialTable::setMaterial(uint32_t index, const MaterialUniformBuffer &parameters, const TableTexture &diffuseTexture)
+    {
+        this->_entries[index].parameters = parameters;
+        this->_entries[index].diffuseTexture = diffuseTexture;
+    }
+
+    void MaterialTable::setLight(const vk::DescriptorBufferInfo &lightBufferInfo)
+    {
+        if (this->_lightBufferInfo == lightBufferInfo)
+            return;
+        this->_lightBufferInfo = lightBufferInfo;
+        vk::WriteDescriptorSet descriptorWrite(this->_descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &this->_lightBufferInfo);
+        this->_device.updateDescriptorSets(descriptorWrite, nullptr);
+    }
+
+    const vk::DescriptorSetLayout &MaterialTable::getDescriptorSetLayout() const
+    {
+        return (this->_descriptorSetLayout);
+    }
+
+    const vk::DescriptorSet &MaterialTable::getDescriptorSet() const
+    {
+        return (this->_descriptorSet);
+    }
+
+    uint32_t MaterialTable::getTextureCapacity() const
+    {
+        return (this->_textureCapacity);
+    }
+
+    uint32_t MaterialTable::getTextureArrayCapacity() const
+    {
+        return (this->_arrayCapacity);
+    }
+
+    void MaterialTable::createWhiteTexture(const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties)
+    {
+        const uint32_t white = 0xFFFFFFFF;
+
+        // A single texel, sampled straight from the linear image
+        Tools::createImage(this->_device, memProperties, 1, 1, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eLinear, vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_whiteImage, this->_whiteImageMemory);
+        vk::SubresourceLayout layout = this->_device.getImageSubresourceLayout(this->_whiteImage, vk::ImageSubresource(vk::ImageAspectFlagBits::eColor, 0, 0));
+        void *data = this->_device.mapMemory(this->_whiteImageMemory, layout.offset, sizeof(white));
+        memcpy(data, &white, sizeof(white));
+        this->_device.unmapMemory(this->_whiteImageMemory);
+        Tools::transitionImageLayout(this->_device, graphicsQueue, commandPool, this->_whiteImage, vk::ImageLayout::ePreinitialized, vk::ImageLayout::eShaderReadOnlyOptimal);
+        Tools::createImageView(this->_device, this->_whiteImage, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, this->_whiteImageView);
+        Tools::createImageView(this->_device, this->_whiteImage, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, this->_whiteArrayView, 0, 1, vk::ImageViewType::e2DArray, 1);
+        // The sampler of the textures, a single texel reads the same with any filter and every slot shares it
+        this->_whiteSampler = this->_samplerCache.getSampler(Texture::getSamplerInfo());
+    }
+
+    void MaterialTable::createDescriptorSet()
+    {
+        const vk::Sampler *immutableSampler = this->_samplerCache.getImmutableSampler(Texture::getSamplerInfo());
+        std::vector<vk::Sampler> immutableSamplers(immutableSampler ? std::max(this->_textureCapacity, this->_arrayCapacity) : 0, immutableSampler ? *immutableSampler : vk::Sampler());
+        std::vector<vk::DescriptorSetLayoutBinding> bindings =
+        {
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eCombinedImageSampler, this->_textureCapacity, vk::ShaderStageFlagBits::eFragment, immutableSampler ? immutableSamplers.data() : nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment),
+            vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eCombinedImageSampler, this->_arrayCapacity, vk::ShaderStageFlagBits::eFragment, immutableSampler ? immutableSamplers.data() : nullptr)
+        };
+        std::vector<vk::DescriptorPoolSize> poolSizes = { vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 2), vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, this->_textureCapacity + this->_arrayCapacity) };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo(vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data());
+        vk::DescriptorPoolCreateInfo poolInfo(vk::DescriptorPoolCreateFlags(), 1, static_cast<uint32_t>(poolSizes.size()), poolSizes.data());
+#ifdef VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+        // Slots may stay unwritten and textures can be added while command buffers using the set are pending
+        std::array<vk::DescriptorBindingFlagsEXT, 4> bindingFlags = { vk::DescriptorBindingFlagsEXT(), vk::DescriptorBindingFlagBitsEXT::ePartiallyBound | vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind, vk::DescriptorBindingFlagsEXT(), vk::DescriptorBindingFlagBitsEXT::ePartiallyBound | vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind };
+        vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo(static_cast<uint32_t>(bindingFlags.size()), bindingFlags.data());
+        if (this->_descriptorIndexing)
+        {
+            layoutInfo.setPNext(&bindingFlagsInfo);
+            layoutInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT);
+            poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT);
+        }
+#endif
+        this->_descriptorSetLayout = this->_device.createDescriptorSetLayout(layoutInfo, CUSTOM_ALLOCATOR);
+        this->_descriptorPool = this->_device.createDescriptorPool(poolInfo, CUSTOM_ALLOCATOR);
+        vk::DescriptorSetAllocateInfo allocInfo(this->_descriptorPool, 1, &this->_descriptorSetLayout);
+        this->_descriptorSet = this->_device.allocateDescriptorSets(allocInfo).front();
+
+        vk::DescriptorBufferInfo bufferInfo(this->_buffer, 0, VK_WHOLE_SIZE);
+        // Without partially bound descriptors every slot has to be valid, they all start white
+        std::vector<vk::DescriptorImageInfo> whiteInfos(this->_descriptorIndexing ? 1 : this->_textureCapacity, vk::DescriptorImageInfo(this->_whiteSampler, this->_whiteImageView, vk::ImageLayout::eShaderReadOnlyOptimal));
+        std::vector<vk::DescriptorImageInfo> whiteArrayInfos(this->_arrayCapacity, vk::DescriptorImageInfo(this->_whiteSampler, this->_whiteArrayView, vk::ImageLayout::eShaderReadOnlyOptimal));
+        std::vector<vk::WriteDescriptorSet> descriptorWrites = { vk::WriteDescriptorSet(this->_descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfo), vk::WriteDescriptorSet(this->_descriptorSet, 1, 0, static_cast<uint32_t>(whiteInfos.size()), vk::DescriptorType::eCombinedImageSampler, whiteInfos.data()) };
+        // Slots of arrays are taken from 0, without partially bound descriptors they all have to be valid
+        if (!this->_descriptorIndexing)
+            descriptorWrites.push_back(vk::WriteDescriptorSet(this->_descriptorSet, 3, 0, static_cast<uint32_t>(whiteArrayInfos.size()), vk::DescriptorType::eCombinedImageSampler, whiteArrayInfos.data()));
+        this->_device.updateDescriptorSets(descriptorWrites, nullptr);
+        this->_textureCount = 1;
+    }
+
+    void MaterialTable::createBuffer(const vk::PhysicalDeviceMemoryProperties &memProperties)
+    {
+        vk::DeviceSize size = sizeof(MaterialEntry) * DWARF_BINDLESS_MAX_MATERIALS;
+
+        // Written by the host whenever a material is built, kept mapped
+        Tools::createBuffer(this->_device, memProperties, size, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_buffer, this->_bufferMemory);
+        this->_entries = static_cast<MaterialEntry *>(this->_device.mapMemory(this->_bufferMemory, 0, size));
+        memset(this->_entries, 0, static_cast<size_t>(size));
+    }
+}
@@ -6,11 +6,16 @@
 namespace Dwarf
 {
 	Mesh::Mesh(const vk::Device &device, Dwarf::MaterialManager &materialManager, const std::string &meshFilename, const vk::DescriptorBufferInfo &lightBufferInfo)
-		: _device(device), _lightBufferInfo(lightBufferInfo)
+		: _device(device), _lightBufferInfo(lightBufferInfo), _static(false)
 	{
 		this->loadFromFile(materialManager, meshFilename);
 	}
 
+    Mesh::Mesh(const vk::Device &device, const vk::DescriptorBufferInfo &lightBufferInfo)
+        : _device(device), _lightBufferInfo(lightBufferInfo), _static(false)
+    {
+    }
+
 	Mesh::~Mesh()
 	{
         for (const auto &submesh : this->_submeshes)
@@ -32,7 +37,7 @@ namespace Dwarf
         this->_submeshes.push_back(Submesh(materialManager.getMaterial("default"), this->_transformationMatrix, this->_lightBufferInfo));
 		for (const auto &material : materials)
 		{
-            tmpMaterial = materialManager.createMaterial(material.name, !material.diffuse_texname.empty());
+            tmpMaterial = materialManager.createMaterial(material.name, !material.diffuse_texname.empty(), material.dissolve < 1.0f);
             tmpMaterial->setAmbient(Color(material.ambient[0], material.ambient[1], material.ambient[2]));
             tmpMaterial->setDiffuse(Color(material.diffuse[0], material.diffuse[1], material.diffuse[2]));
             tmpMaterial->setSpecular(Color(material.specular[0], material.specular[1], material.specular[2]));
@@ -73,6 +78,8 @@ namespace Dwarf
 				tmpMaterial->createEmissiveTexture(material.emissive_texname);
 			if (!material.normal_texname.empty())
 				tmpMaterial->createNormalTexture(material.normal_texname);*/
+            // Libraries of other models often repeat the same materials under other names
+            tmpMaterial = materialManager.internMaterial(tmpMaterial);
             this->_submeshes.push_back(Submesh(tmpMaterial, this->_transformationMatrix, this->_lightBufferInfo));
             tmpMaterial = nullptr;
 		}
@@ -125,10 +132,21 @@ namespace Dwarf
             LOG(INFO) << "TinyOBJLoader: vertices number(" << submeshVertices.at(s).size() << ") with indices number (" << submeshIndices.at(s).size() << ")";
             this->_submeshes.at(s).setVertices(submeshVertices.at(s));
             this->_submeshes.at(s).setIndices(submeshIndices.at(s));
+            this->_submeshes.at(s).buildMeshlets();
+            this->_submeshes.at(s).generateLods();
             ++s;
         }
 	}
 
+    void Mesh::addSubmesh(Material *material, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+    {
+        this->_submeshes.push_back(Submesh(material, this->_transformationMatrix, this->_lightBufferInfo));
+        this->_submeshes.back().setVertices(vertices);
+        this->_submeshes.back().setIndices(indices);
+        this->_submeshes.back().buildMeshlets();
+        this->_submeshes.back().generateLods();
+    }
+
     std::vector<IBuildable *> Mesh::getBuildables()
     {
         std::vector<IBuildable *> buildables;
@@ -145,6 +163,16 @@ namespace Dwarf
         return (this->_submeshes);
     }
 
+    void Mesh::setStatic(bool isStatic)
+    {
+        this->_static = isStatic;
+    }
+
+    bool Mesh::isStatic() const
+    {
+        return (this->_static);
+    }
+
     TmpMesh::TmpMesh()
     {
     }
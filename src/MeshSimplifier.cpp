@@ -0,0 +1,247 @@
+#include "MeshSimplifier.h"
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace Dwarf
+{
+    MeshSimplifier::Quadric::Quadric()
+        : a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0), b0(0.0), b1(0.0), b2(0.0), c(0.0), weight(0.0)
+    {
+    }
+
+    MeshSimplifier::Quadric::Quadric(const glm::vec3 &normal, float distance, float weight)
+        : weight(weight)
+    {
+        this->a00 = weight * normal.x * normal.x;
+        this->a01 = weight * normal.x * normal.y;
+        this->a02 = weight * normal.x * normal.z;
+        this->a11 = weight * normal.y * normal.y;
+        this->a12 = weight * normal.y * normal.z;
+        this->a22 = weight * normal.z * normal.z;
+        this->b0 = weight * normal.x * distance;
+        this->b1 = weight * normal.y * distance;
+        this->b2 = weight * normal.z * distance;
+        this->c = weight * distance * distance;
+    }
+
+    MeshSimplifier::Quadric &MeshSimplifier::Quadric::operator+=(const Quadric &rhs)
+    {
+        this->a00 += rhs.a00;
+        this->a01 += rhs.a01;
+        this->a02 += rhs.a02;
+        this->a11 += rhs.a11;
+        this->a12 += rhs.a12;
+        this->a22 += rhs.a22;
+        this->b0 += rhs.b0;
+        this->b1 += rhs.b1;
+        this->b2 += rhs.b2;
+        this->c += rhs.c;
+        this->weight += rhs.weight;
+        return (*this);
+    }
+
+    float MeshSimplifier::Quadric::evaluate(const glm::vec3 &position) const
+    {
+        if (this->weight <= 0.0)
+            return (0.0f);
+        double x = position.x;
+        double y = position.y;
+        double z = position.z;
+        double error = this->a00 * x * x + 2.0 * this->a01 * x * y + 2.0 * this->a02 * x * z + this->a11 * y * y + 2.0 * this->a12 * y * z + this->a22 * z * z
+            + 2.0 * (this->b0 * x + this->b1 * y + this->b2 * z) + this->c;
+        // Squared distance to the planes, averaged by area
+        return (static_cast<float>(std::max(error, 0.0) / this->weight));
+    }
+
+    MeshSimplifier::MeshSimplifier(const std::vector<Vertex> &vertices)
+        : _vertices(vertices)
+    {
+        std::unordered_map<glm::vec3, uint32_t> positions;
+        std::vector<uint32_t> groupSizes(this->_vertices.size(), 0);
+        uint32_t i = 0;
+
+        this->_positionRemap.resize(this->_vertices.size());
+        for (const auto &vertex : this->_vertices)
+        {
+            auto it = positions.insert(std::make_pair(vertex.pos, i)).first;
+            this->_positionRemap.at(i) = it->second;
+            ++groupSizes.at(it->second);
+            ++i;
+        }
+        this->_seams.resize(this->_vertices.size());
+        i = 0;
+        for (const auto &remap : this->_positionRemap)
+        {
+            this->_seams.at(i) = groupSizes.at(remap) > 1;
+            ++i;
+        }
+    }
+
+    MeshSimplifier::~MeshSimplifier()
+    {
+    }
+
+    float MeshSimplifier::simplify(const std::vector<uint32_t> &indices, size_t targetIndexCount, std::vector<uint32_t> &result) const
+    {
+        size_t vertexCount = this->_vertices.size();
+        std::unordered_map<uint64_t, uint32_t> edgeCounts;
+        std::vector<bool> locked(this->_seams);
+        std::vector<Quadric> quadrics(vertexCount);
+        std::vector<uint32_t> collapseTo(vertexCount);
+        std::vector<bool> touched(vertexCount);
+        std::vector<uint32_t> adjacencyOffsets;
+        std::vector<uint32_t> adjacency;
+        std::vector<Collapse> collapses;
+        float maxError = 0.0f;
+        size_t t;
+        size_t e;
+
+        result = indices;
+        if (result.size() <= targetIndexCount)
+            return (0.0f);
+        auto edgeKey = [this](uint32_t a, uint32_t b)
+        {
+            a = this->_positionRemap.at(a);
+            b = this->_positionRemap.at(b);
+            return (static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+        };
+        for (t = 0; t + 2 < result.size(); t += 3)
+        {
+            for (e = 0; e < 3; ++e)
+                ++edgeCounts[edgeKey(result.at(t + e), result.at(t + (e + 1) % 3))];
+        }
+        for (t = 0; t + 2 < result.size(); t += 3)
+        {
+            const glm::vec3 &p0 = this->_vertices.at(result.at(t)).pos;
+            const glm::vec3 &p1 = this->_vertices.at(result.at(t + 1)).pos;
+            const glm::vec3 &p2 = this->_vertices.at(result.at(t + 2)).pos;
+            for (e = 0; e < 3; ++e)
+            {
+                if (edgeCounts.at(edgeKey(result.at(t + e), result.at(t + (e + 1) % 3))) == 1)
+                {
+                    locked.at(result.at(t + e)) = true;
+                    locked.at(result.at(t + (e + 1) % 3)) = true;
+                }
+            }
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normal /= length;
+            Quadric quadric(normal, -glm::dot(normal, p0), length * 0.5f);
+            for (e = 0; e < 3; ++e)
+                quadrics.at(this->_positionRemap.at(result.at(t + e))) += quadric;
+        }
+
+        while (result.size() > targetIndexCount)
+        {
+            adjacencyOffsets.assign(vertexCount + 1, 0);
+            for (const auto &index : result)
+                ++adjacencyOffsets.at(index + 1);
+            for (size_t v = 0; v < vertexCount; ++v)
+                adjacencyOffsets.at(v + 1) += adjacencyOffsets.at(v);
+            adjacency.resize(result.size());
+            std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (t = 0; t < result.size(); ++t)
+                adjacency.at(cursors.at(result.at(t))++) = static_cast<uint32_t>(t / 3);
+
+            collapses.clear();
+            for (t = 0; t + 2 < result.size(); t += 3)
+            {
+                for (e = 0; e < 3; ++e)
+                {
+                    uint32_t a = result.at(t + e);
+                    uint32_t b = result.at(t + (e + 1) % 3);
+                    if (this->_positionRemap.at(a) == this->_positionRemap.at(b))
+                        continue;
+                    Quadric quadric = quadrics.at(this->_positionRemap.at(a));
+                    quadric += quadrics.at(this->_positionRemap.at(b));
+                    if (!locked.at(a))
+                        collapses.push_back({ a, b, quadric.evaluate(this->_vertices.at(b).pos) });
+                    if (!locked.at(b))
+                        collapses.push_back({ b, a, quadric.evaluate(this->_vertices.at(a).pos) });
+                }
+            }
+            if (collapses.empty())
+                break;
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &lhs, const Collapse &rhs) { return (lhs.error < rhs.error); });
+
+            for (size_t v = 0; v < vertexCount; ++v)
+                collapseTo.at(v) = static_cast<uint32_t>(v);
+            std::fill(touched.begin(), touched.end(), false);
+            size_t triangleCount = result.size() / 3;
+            size_t collapsed = 0;
+            for (const auto &collapse : collapses)
+            {
+                if (triangleCount * 3 <= targetIndexCount)
+                    break;
+                if (touched.at(collapse.from) || touched.at(collapse.to) || this->flips(result, adjacencyOffsets, adjacency, collapse.from, collapse.to))
+                    continue;
+                // Every vertex sharing a triangle with the collapsed one waits for the next pass
+                for (uint32_t a = adjacencyOffsets.at(collapse.from); a < adjacencyOffsets.at(collapse.from + 1); ++a)
+                {
+                    bool removed = false;
+                    for (e = 0; e < 3; ++e)
+                    {
+                        uint32_t index = result.at(adjacency.at(a) * 3 + e);
+                        touched.at(index) = true;
+                        removed = removed || this->_positionRemap.at(index) == this->_positionRemap.at(collapse.to);
+                    }
+                    if (removed)
+                        --triangleCount;
+                }
+                collapseTo.at(collapse.from) = collapse.to;
+                quadrics.at(this->_positionRemap.at(collapse.to)) += quadrics.at(this->_positionRemap.at(collapse.from));
+                maxError = std::max(maxError, collapse.error);
+                ++collapsed;
+            }
+            if (collapsed == 0)
+                break;
+
+            size_t write = 0;
+            for (t = 0; t + 2 < result.size(); t += 3)
+            {
+                uint32_t a = collapseTo.at(result.at(t));
+                uint32_t b = collapseTo.at(result.at(t + 1));
+                uint32_t c = collapseTo.at(result.at(t + 2));
+                if (this->_positionRemap.at(a) == this->_positionRemap.at(b) || this->_positionRemap.at(b) == this->_positionRemap.at(c) || this->_positionRemap.at(a) == this->_positionRemap.at(c))
+                    continue;
+                result.at(write++) = a;
+                result.at(write++) = b;
+                result.at(write++) = c;
+            }
+            result.resize(write);
+        }
+        return (std::sqrt(maxError));
+    }
+
+    bool MeshSimplifier::flips(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &adjacencyOffsets, const std::vector<uint32_t> &adjacency, uint32_t from, uint32_t to) const
+    {
+        for (uint32_t a = adjacencyOffsets.at(from); a < adjacencyOffsets.at(from + 1); ++a)
+        {
+            std::array<uint32_t, 3> triangle = { indices.at(adjacency.at(a) * 3), indices.at(adjacency.at(a) * 3 + 1), indices.at(adjacency.at(a) * 3 + 2) };
+            std::array<glm::vec3, 3> positions;
+            bool degenerate = false;
+            for (size_t e = 0; e < 3; ++e)
+            {
+                positions.at(e) = this->_vertices.at(triangle.at(e)).pos;
+                degenerate = degenerate || this->_positionRemap.at(triangle.at(e)) == this->_positionRemap.at(to);
+            }
+            if (degenerate)
+                continue;
+            glm::vec3 before = glm::cross(positions.at(1) - positions.at(0), positions.at(2) - positions.at(0));
+            for (size_t e = 0; e < 3; ++e)
+            {
+                if (triangle.at(e) == from)
+                    positions.at(e) = this->_vertices.at(to).pos;
+            }
+            glm::vec3 after = glm::cross(positions.at(1) - positions.at(0), positions.at(2) - positions.at(0));
+            if (glm::dot(before, after) <= 0.0f)
+                return (true);
+        }
+        return (false);
+    }
+}
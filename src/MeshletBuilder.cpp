@@ -0,0 +1,166 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Dwarf
+{
+    MeshletBuilder::MeshletBuilder(const std::vector<Vertex> &vertices)
+        : _vertices(vertices)
+    {
+    }
+
+    MeshletBuilder::~MeshletBuilder()
+    {
+    }
+
+    void MeshletBuilder::build(std::vector<uint32_t> &indices, std::vector<Meshlet> &meshlets) const
+    {
+        const uint32_t none = std::numeric_limits<uint32_t>::max();
+        size_t triangleCount = indices.size() / 3;
+        std::vector<uint32_t> adjacencyOffsets(this->_vertices.size() + 1, 0);
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> vertexMeshlet(this->_vertices.size(), none);
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint32_t> result;
+        Meshlet meshlet = {};
+        uint32_t meshletID = 0;
+        uint32_t lastTriangle = none;
+        uint32_t best;
+        uint32_t bestNewVertices;
+        size_t seed = 0;
+        size_t t;
+
+        meshlets.clear();
+        result.reserve(triangleCount * 3);
+        for (t = 0; t < triangleCount * 3; ++t)
+            ++adjacencyOffsets.at(indices.at(t) + 1);
+        for (t = 0; t < this->_vertices.size(); ++t)
+            adjacencyOffsets.at(t + 1) += adjacencyOffsets.at(t);
+        std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (t = 0; t < triangleCount * 3; ++t)
+            adjacency.at(cursors.at(indices.at(t))++) = static_cast<uint32_t>(t / 3);
+
+        auto newVertices = [&](uint32_t triangle)
+        {
+            uint32_t count = 0;
+            for (size_t e = 0; e < 3; ++e)
+                count += vertexMeshlet.at(indices.at(triangle * 3 + e)) != meshletID ? 1 : 0;
+            return (count);
+        };
+        auto findNeighbour = [&](uint32_t vertex)
+        {
+            for (uint32_t a = adjacencyOffsets.at(vertex); a < adjacencyOffsets.at(vertex + 1); ++a)
+            {
+                uint32_t triangle = adjacency.at(a);
+                if (emitted.at(triangle))
+                    continue;
+                uint32_t count = newVertices(triangle);
+                if (count < bestNewVertices)
+                {
+                    best = triangle;
+                    bestNewVertices = count;
+                }
+            }
+        };
+        auto flush = [&]()
+        {
+            meshlet.indexCount = static_cast<uint32_t>(result.size()) - meshlet.firstIndex;
+            this->computeBounds(result, meshlet);
+            meshlets.push_back(meshlet);
+            meshlet.firstIndex = static_cast<uint32_t>(result.size());
+            meshletVertices.clear();
+            lastTriangle = none;
+            ++meshletID;
+        };
+
+        while (true)
+        {
+            // Grow from the last triangle first, then from anywhere on the meshlet
+            best = none;
+            bestNewVertices = 4;
+            if (lastTriangle != none)
+            {
+                for (size_t e = 0; e < 3; ++e)
+                    findNeighbour(indices.at(lastTriangle * 3 + e));
+                if (best == none)
+                {
+                    for (const auto &vertex : meshletVertices)
+                        findNeighbour(vertex);
+                }
+            }
+            if (best != none && (meshletVertices.size() + bestNewVertices > DWARF_MESHLET_MAX_VERTICES || result.size() - meshlet.firstIndex >= DWARF_MESHLET_MAX_TRIANGLES * 3))
+                flush();
+            if (best == none)
+            {
+                if (result.size() > meshlet.firstIndex)
+                    flush();
+                while (seed < triangleCount && emitted.at(seed))
+                    ++seed;
+                if (seed == triangleCount)
+                    break;
+                best = static_cast<uint32_t>(seed);
+            }
+            for (size_t e = 0; e < 3; ++e)
+            {
+                uint32_t vertex = indices.at(best * 3 + e);
+                if (vertexMeshlet.at(vertex) != meshletID)
+                {
+                    vertexMeshlet.at(vertex) = meshletID;
+                    meshletVertices.push_back(vertex);
+                }
+                result.push_back(vertex);
+            }
+            emitted.at(best) = true;
+            lastTriangle = best;
+        }
+        indices.swap(result);
+    }
+
+    void MeshletBuilder::computeBounds(const std::vector<uint32_t> &indices, Meshlet &meshlet) const
+    {
+        glm::vec3 minimum = this->_vertices.at(indices.at(meshlet.firstIndex)).pos;
+        glm::vec3 maximum = minimum;
+        uint32_t end = meshlet.firstIndex + meshlet.indexCount;
+        uint32_t i;
+
+        for (i = meshlet.firstIndex; i < end; ++i)
+        {
+            minimum = glm::min(minimum, this->_vertices.at(indices.at(i)).pos);
+            maximum = glm::max(maximum, this->_vertices.at(indices.at(i)).pos);
+        }
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radius = 0.0f;
+        for (i = meshlet.firstIndex; i < end; ++i)
+            radius = std::max(radius, glm::length(this->_vertices.at(indices.at(i)).pos - center));
+        meshlet.boundingSphere = glm::vec4(center, radius);
+
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (i = meshlet.firstIndex; i + 2 < end; i += 3)
+        {
+            const glm::vec3 &p0 = this->_vertices.at(indices.at(i)).pos;
+            glm::vec3 normal = glm::cross(this->_vertices.at(indices.at(i + 1)).pos - p0, this->_vertices.at(indices.at(i + 2)).pos - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+        float axisLength = glm::length(axis);
+        if (normals.empty() || axisLength <= 0.0f)
+        {
+            meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            return;
+        }
+        axis /= axisLength;
+        float minimumDot = 1.0f;
+        for (const auto &normal : normals)
+            minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+        // Close to a half sphere of normals, the cone would never cull anything
+        float cutoff = minimumDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+        meshlet.cone = glm::vec4(axis, cutoff);
+    }
+}
@@ -0,0 +1,124 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Dwarf
+{
+    PipelineCache::PipelineCache(const vk::Device &device, const vk::PhysicalDeviceProperties &properties)
+        : _device(device), _properties(properties), _warm(false), _creations(0), _creationTime(0)
+    {
+        std::ostringstream path;
+        path << "pipelines_";
+        for (const auto &byte : this->_properties.pipelineCacheUUID)
+            path << std::hex << std::setw(2) << std::setfill('0') << static_cast<uint32_t>(byte);
+        path << "_" << std::dec << this->_properties.driverVersion << ".cache";
+        this->_path = path.str();
+
+        std::vector<char> data = this->load();
+        vk::PipelineCacheCreateInfo cacheInfo(vk::PipelineCacheCreateFlags(), data.size(), data.empty() ? nullptr : data.data());
+        this->_cache = this->_device.createPipelineCache(cacheInfo, CUSTOM_ALLOCATOR);
+        this->_warm = !data.empty();
+        LOG(INFO) << "PipelineCache: " << (data.empty() ? "starting empty" : "loaded " + std::to_string(data.size()) + " bytes from " + this->_path);
+    }
+
+    PipelineCache::~PipelineCache()
+    {
+        this->logStatistics();
+        this->save();
+        this->_device.destroyPipelineCache(this->_cache, CUSTOM_ALLOCATOR);
+    }
+
+    vk::Pipeline PipelineCache::createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo &pipelineInfo)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        vk::Pipeline pipeline = this->_device.createGraphicsPipeline(this->_cache, pipelineInfo, CUSTOM_ALLOCATOR);
+        this->record(start);
+        return (pipeline);
+    }
+
+    vk::Pipeline PipelineCache::createComputePipeline(const vk::ComputePipelineCreateInfo &pipelineInfo)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        vk::Pipeline pipeline = this->_device.createComputePipeline(this->_cache, pipelineInfo, CUSTOM_ALLOCATOR);
+        this->record(start);
+        return (pipeline);
+    }
+
+    void PipelineCache::save() const
+    {
+        std::vector<uint8_t> data = this->_device.getPipelineCacheData(this->_cache);
+        if (data.empty())
+            return;
+        std::ofstream file(this->_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOG(WARNING) << "PipelineCache: could not write " << this->_path;
+            return;
+        }
+        FileHeader header = { DWARF_PIPELINECACHE_MAGIC, this->_properties.driverVersion, data.size() };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    }
+
+    void PipelineCache::logStatistics() const
+    {
+        uint32_t creations = this->_creations.load();
+        if (creations == 0)
+            return;
+        LOG(INFO) << "PipelineCache: " << creations << " pipelines created from a " << (this->_warm ? "warm" : "cold") << " cache in " << static_cast<float>(this->_creationTime.load()) / 1000.0f << " ms";
+    }
+
+    const vk::PipelineCache &PipelineCache::getCache() const
+    {
+        return (this->_cache);
+    }
+
+    std::vector<char> PipelineCache::load() const
+    {
+        std::ifstream file(this->_path, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+            return (std::vector<char>());
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        FileHeader header = {};
+        file.seekg(0);
+        if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return (std::vector<char>());
+        if (header.magic != DWARF_PIPELINECACHE_MAGIC || header.driverVersion != this->_properties.driverVersion || header.dataSize != fileSize - sizeof(header))
+        {
+            LOG(WARNING) << "PipelineCache: discarding " << this->_path << ", written by another driver or truncated";
+            return (std::vector<char>());
+        }
+        std::vector<char> data(static_cast<size_t>(header.dataSize));
+        if (!file.read(data.data(), data.size()) || !this->isValid(data))
+        {
+            LOG(WARNING) << "PipelineCache: discarding " << this->_path << ", header does not match the device";
+            return (std::vector<char>());
+        }
+        return (data);
+    }
+
+    bool PipelineCache::isValid(const std::vector<char> &data) const
+    {
+        // Header of VK_PIPELINE_CACHE_HEADER_VERSION_ONE: length, version, vendor, device then the UUID
+        uint32_t fields[4];
+        if (data.size() < sizeof(fields) + VK_UUID_SIZE)
+            return (false);
+        std::memcpy(fields, data.data(), sizeof(fields));
+        return (fields[0] >= sizeof(fields) + VK_UUID_SIZE && fields[0] <= data.size()
+            && fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && fields[2] == this->_properties.vendorID
+            && fields[3] == this->_properties.deviceID
+            && std::memcmp(data.data() + sizeof(fields), this->_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+    }
+
+    void PipelineCache::record(const std::chrono::high_resolution_clock::time_point &start)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        // Summed over the compiling threads, parallel creations count their overlapping time once each
+        this->_creationTime += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        ++this->_creations;
+    }
+}
@@ -0,0 +1,127 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace Dwarf
+{
+    RenderQueue::RenderQueue(ThreadPool &threadPool, const uint32_t &numThreads)
+        : _threadPool(threadPool), _numThreads(numThreads)
+    {
+    }
+
+    RenderQueue::~RenderQueue()
+    {
+    }
+
+    void RenderQueue::clear()
+    {
+        this->_items.clear();
+    }
+
+    void RenderQueue::push(uint64_t key, IBuildable *buildable)
+    {
+        this->_items.push_back({ key, buildable });
+    }
+
+    void RenderQueue::sort()
+    {
+        const size_t radixSize = static_cast<size_t>(1) << DWARF_RENDERQUEUE_RADIX_BITS;
+        size_t count = this->_items.size();
+        if (count < 2)
+            return;
+        size_t threadCount = count >= DWARF_RENDERQUEUE_PARALLEL_THRESHOLD ? std::max(this->_numThreads, 1u) : 1;
+        size_t t;
+
+        this->_sortBuffer.resize(count);
+        this->_histograms.resize(threadCount);
+        for (uint32_t shift = 0; shift < 64; shift += DWARF_RENDERQUEUE_RADIX_BITS)
+        {
+            if (threadCount > 1)
+            {
+                for (t = 0; t < threadCount; ++t)
+                    this->_threadPool.addJobThread(static_cast<uint32_t>(t), std::bind(&RenderQueue::countDigits, this, t, threadCount, shift));
+                this->_threadPool.wait();
+            }
+            else
+                this->countDigits(0, 1, shift);
+
+            // Turn the counts in scatter offsets, digit major then thread so that the sort stays stable
+            size_t offset = 0;
+            bool sorted = false;
+            for (size_t digit = 0; digit < radixSize && !sorted; ++digit)
+            {
+                size_t total = 0;
+                for (t = 0; t < threadCount; ++t)
+                {
+                    size_t digitCount = this->_histograms.at(t).at(digit);
+                    this->_histograms.at(t).at(digit) = offset + total;
+                    total += digitCount;
+                }
+                // Every key shares this digit (usually the pass), nothing to move
+                sorted = total == count;
+                offset += total;
+            }
+            if (sorted)
+                continue;
+
+            if (threadCount > 1)
+            {
+                for (t = 0; t < threadCount; ++t)
+                    this->_threadPool.addJobThread(static_cast<uint32_t>(t), std::bind(&RenderQueue::scatterDigits, this, t, threadCount, shift));
+                this->_threadPool.wait();
+            }
+            else
+                this->scatterDigits(0, 1, shift);
+            this->_items.swap(this->_sortBuffer);
+        }
+    }
+
+    uint32_t RenderQueue::getPipelineID(const vk::Pipeline &pipeline)
+    {
+        auto it = this->_pipelineIDs.insert(std::make_pair(static_cast<VkPipeline>(pipeline), static_cast<uint32_t>(this->_pipelineIDs.size()))).first;
+        return (it->second);
+    }
+
+    const std::vector<RenderItem> &RenderQueue::getItems() const
+    {
+        return (this->_items);
+    }
+
+    uint64_t RenderQueue::makeKey(DrawPass pass, uint32_t pipelineID, uint32_t materialID, float depth)
+    {
+        uint32_t depthBits;
+
+        // Positive floats compare like their bit patterns
+        depth = std::max(depth, 0.0f);
+        std::memcpy(&depthBits, &depth, sizeof(depthBits));
+        // Blending needs a global order, the states only break ties
+        if (pass == DRAW_TRANSPARENT)
+            return ((static_cast<uint64_t>(pass & 0xF) << 60) | (static_cast<uint64_t>(~depthBits >> 4) << 32) | (static_cast<uint64_t>(pipelineID & 0xFFF) << 16) | (materialID & 0xFFFF));
+        return ((static_cast<uint64_t>(pass & 0xF) << 60) | (static_cast<uint64_t>(pipelineID & 0xFFF) << 48) | (static_cast<uint64_t>(materialID & 0xFFFF) << 32) | depthBits);
+    }
+
+    void RenderQueue::countDigits(size_t threadIndex, size_t threadCount, uint32_t shift)
+    {
+        const uint64_t mask = (static_cast<uint64_t>(1) << DWARF_RENDERQUEUE_RADIX_BITS) - 1;
+        std::vector<size_t> &histogram = this->_histograms.at(threadIndex);
+        size_t begin = this->_items.size() * threadIndex / threadCount;
+        size_t end = this->_items.size() * (threadIndex + 1) / threadCount;
+
+        histogram.assign(static_cast<size_t>(mask + 1), 0);
+        for (size_t i = begin; i < end; ++i)
+            ++histogram[static_cast<size_t>((this->_items[i].key >> shift) & mask)];
+    }
+
+    void RenderQueue::scatterDigits(size_t threadIndex, size_t threadCount, uint32_t shift)
+    {
+        const uint64_t mask = (static_cast<uint64_t>(1) << DWARF_RENDERQUEUE_RADIX_BITS) - 1;
+        std::vector<size_t> &offsets = this->_histograms.at(threadIndex);
+        size_t begin = this->_items.size() * threadIndex / threadCount;
+        size_t end = this->_items.size() * (threadIndex + 1) / threadCount;
+
+        for (size_t i = begin; i < end; ++i)
+            this->_sortBuffer[offsets[static_cast<size_t>((this->_items[i].key >> shift) & mask)]++] = this->_items[i];
+    }
+}
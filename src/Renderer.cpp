@@ -4,34 +4,68 @@
 namespace Dwarf
 {
 	Renderer::Renderer(int width, int height, const std::string &title, bool fifo)
-		: _title(title), _mousePos(static_cast<float>(width) / 2.0f, static_cast<float>(height) / 2.0f), _fifo(fifo)
+		: _title(title), _mousePos(static_cast<float>(width) / 2.0f, static_cast<float>(height) / 2.0f), _fifo(fifo), _textureStreamer(nullptr), _materialTable(nullptr), _bindless(false), _descriptorIndexing(false), _pendingExtent(static_cast<uint32_t>(width), static_cast<uint32_t>(height)), _resizePending(false)
 	{
         this->_numThreads = std::thread::hardware_concurrency();
         this->_threadPool.setThreadCount(this->_numThreads);
-        this->_commandBufferBuilder = new CommandBuffersBuilder(this->_device, this->_renderPass, this->_swapChainFramebuffers, this->_swapChainExtent, this->_threadPool, this->_numThreads);
+        this->_commandBufferBuilder = new CommandBuffersBuilder(this->_device, this->_renderPass, this->_renderPassLoad, this->_swapChainFramebuffers, this->_swapChainExtent, this->_threadPool, this->_numThreads);
         this->createWindow(width, height, title);
 		this->createInstance();
 		this->setupDebugCallback();
 		this->createSurface();
 		this->pickPhysicalDevice();
 		this->createLogicalDevice();
+        this->_pipelineCache = new PipelineCache(this->_device, this->_physicalDevice.getProperties());
+        this->_shaderLibrary = new ShaderLibrary(this->_device);
+        this->_samplerCache = new SamplerCache(this->_device, gImmutableSamplers);
+        // A single frame in flight, the previous one is complete when the next begins
+        this->_descriptorAllocator = new DescriptorAllocator(this->_device, 1);
 		this->createSwapChain();
 		this->createImageViews();
 		this->createRenderPass();
 		this->createCommandPool();
+        this->_cullingManager = new CullingManager(this->_device, this->_physicalDevice.getMemoryProperties(), this->_graphicsQueue, this->_commandPool, *this->_pipelineCache, *this->_shaderLibrary, *this->_descriptorAllocator);
 		this->createDepthResources();
 		this->createFramebuffers();
         this->_lightManager = new LightManager(this->_device, this->_physicalDevice.getMemoryProperties());
-        this->_materialManager = new MaterialManager(this->_device, this->_graphicsQueue, this->_renderPass, this->_swapChainExtent);
+        // A field of small coloured lights around the model, each only shades the clusters it reaches
+        for (int x = -16; x < 16; ++x)
+        {
+            for (int z = -16; z < 16; ++z)
+                this->_lightManager->addLight(Light(x * 4.0, 1.0, z * 4.0, Color((x + 16) / 32.0f, 0.5f, (z + 16) / 32.0f), 3.0));
+        }
+        if (this->_bindless)
+            this->_materialTable = new MaterialTable(this->_device, this->_graphicsQueue, this->_commandPool, this->_physicalDevice.getMemoryProperties(), this->_physicalDevice.getProperties().limits, *this->_samplerCache, this->_descriptorIndexing);
+        this->_textureUploader = new TextureUploader(this->_device, this->_graphicsQueue, this->_commandPool, this->_physicalDevice.getMemoryProperties());
+        this->_textureManager = new TextureManager(this->_device, *this->_textureUploader, *this->_samplerCache);
+        this->_materialManager = new MaterialManager(this->_device, this->_graphicsQueue, this->_renderPass, *this->_pipelineCache, *this->_shaderLibrary, *this->_descriptorAllocator, *this->_textureManager, *this->_samplerCache, this->_numThreads, this->_materialTable);
         this->_models.push_back(new Mesh(this->_device, *this->_materialManager, "resources/models/CamaroSS.obj", this->_lightManager->getDescriptorBufferInfo()));
         this->_models.back()->setRotation(-90.0, 0.0, 0.0);
         this->_models.back()->setScale(5.0, 5.0, 5.0);
         //this->_models.push_back(new Mesh(this->_device, *this->_materialManager, "resources/models/sphere.obj", this->_lightManager->getDescriptorBufferInfo()));
-        this->_materialManager->createDescriptorPool();
+        // Meshes flagged with setStatic(true) before this point are merged, the car moves with the keys and stays dynamic
+        StaticBatcher staticBatcher(this->_device, this->_lightManager->getDescriptorBufferInfo());
+        staticBatcher.batch(this->_models);
+        this->_materialManager->logStatistics();
+        this->_textureManager->loadTextures(this->_threadPool, this->_numThreads);
+        // Only the material table samples arrays, the per material descriptor sets keep an image per texture
+        if (this->_materialTable)
+            this->_textureManager->packTextures(this->_physicalDevice.getMemoryProperties(), std::min(static_cast<uint32_t>(DWARF_PACKED_MAX_LAYERS), this->_physicalDevice.getProperties().limits.maxImageArrayLayers));
+        this->_textureManager->logStatistics();
+        this->_samplerCache->logStatistics();
         this->_deviceAllocator = new DeviceAllocationManager(this->_device, this->_graphicsQueue, this->_physicalDevice.getMemoryProperties());
         this->_deviceAllocator->allocate(this->_models, this->_commandPool);
+        this->_cullingManager->build(this->_models);
         for (auto &model : this->_models)
             this->_commandBufferBuilder->addBuildables(model->getBuildables());
+        this->_commandBufferBuilder->createBuildableBuffers(this->_graphicsQueue, this->_physicalDevice.getMemoryProperties());
+        this->_textureUploader->flush();
+        if (gTextureStreaming)
+        {
+            this->_textureStreamer = new TextureStreamer(*this->_textureUploader, this->_physicalDevice.getMemoryProperties());
+            this->_textureStreamer->addSubmeshes(this->_models);
+            this->_textureStreamer->logStatistics();
+        }
 		this->createCommandBuffers();
 		this->createSemaphores();
         ModelLoader ml;
@@ -42,12 +76,21 @@ namespace Dwarf
 
 	Renderer::~Renderer()
 	{
+        delete (this->_textureStreamer);
+        delete (this->_cullingManager);
         delete (this->_deviceAllocator);
 		for (auto &model : this->_models)
             delete (model);
         delete (this->_commandBufferBuilder);
         delete (this->_materialManager);
+        delete (this->_materialTable);
+        delete (this->_textureManager);
+        delete (this->_textureUploader);
+        delete (this->_samplerCache);
         delete (this->_lightManager);
+        delete (this->_descriptorAllocator);
+        delete (this->_shaderLibrary);
+        delete (this->_pipelineCache);
 		this->_device.destroySemaphore(this->_renderFinishedSemaphore, CUSTOM_ALLOCATOR);
 		this->_device.destroySemaphore(this->_imageAvailableSemaphore, CUSTOM_ALLOCATOR);
 		if (!this->_commandBuffers.empty())
@@ -56,11 +99,14 @@ namespace Dwarf
 		this->_device.freeMemory(this->_depthImageMemory, CUSTOM_ALLOCATOR);
 		this->_device.destroyImage(this->_depthImage, CUSTOM_ALLOCATOR);
 		this->_device.destroyCommandPool(this->_commandPool, CUSTOM_ALLOCATOR);
+		this->_device.destroyRenderPass(this->_renderPassLoad, CUSTOM_ALLOCATOR);
 		this->_device.destroyRenderPass(this->_renderPass, CUSTOM_ALLOCATOR);
 		for (const auto &framebuffer : this->_swapChainFramebuffers)
             this->_device.destroyFramebuffer(framebuffer, CUSTOM_ALLOCATOR);
         for (const auto &imageView : this->_swapChainImageViews)
             this->_device.destroyImageView(imageView, CUSTOM_ALLOCATOR);
+		if (this->_retiredSwapChain)
+			this->_device.destroySwapchainKHR(this->_retiredSwapChain, CUSTOM_ALLOCATOR);
 		this->_device.destroySwapchainKHR(this->_swapChain, CUSTOM_ALLOCATOR);
 		this->_device.destroy(CUSTOM_ALLOCATOR);
 		this->_instance.destroySurfaceKHR(this->_surface, CUSTOM_ALLOCATOR);
@@ -84,9 +130,20 @@ namespace Dwarf
 		while (!glfwWindowShouldClose(this->_window))
 		{
 			glfwPollEvents();
+			if (this->_resizePending)
+			{
+				// Minimised, nothing to present until the window comes back
+				if (this->_pendingExtent.width == 0 || this->_pendingExtent.height == 0)
+				{
+					glfwWaitEvents();
+					continue;
+				}
+				this->recreateSwapChain();
+			}
 			start = std::chrono::high_resolution_clock::now();
 			this->_camera.update(frameTimer);
             this->_lightManager->updateLightPos(frameTimer);
+            this->_lightManager->updateClusters(this->_camera.getView(), this->_camera.getProjection(), this->_camera.getNear(), this->_camera.getFar(), this->_swapChainExtent);
             if (this->_movance.down)
                 this->_models.at(0)->move(0.0, 0.0, -10 * frameTimer);
             if (this->_movance.up)
@@ -95,8 +152,18 @@ namespace Dwarf
                 this->_models.at(0)->move(-10 * frameTimer, 0.0, 0.0);
             if (this->_movance.right)
                 this->_models.at(0)->move(10 * frameTimer, 0.0, 0.0);
+            this->_cullingManager->update();
+            this->_cullingManager->setLodSelection(this->_camera.getEyePosition(), this->_camera.getFov(), static_cast<float>(this->_swapChainExtent.height));
+            // The previous frame is complete, the descriptors of the streamed textures can be rewritten
+            if (this->_textureStreamer)
+                this->_textureStreamer->update(this->_camera.getMVP(), this->_camera.getEyePosition(), this->_camera.getFov(), static_cast<float>(this->_swapChainExtent.height));
 			this->buildCommandBuffers();
 			this->drawFrame();
+            if (gValidateCulling)
+            {
+                this->_graphicsQueue.waitIdle();
+                this->_cullingManager->validate();
+            }
 			++frameCounter;
 			end = std::chrono::high_resolution_clock::now();
 			diff = std::chrono::duration<float, std::milli>(end - start).count();
@@ -200,9 +267,38 @@ namespace Dwarf
             queueCreateInfo.queueFamilyIndex = uniqueQueueFamily;
             queueCreateInfos.push_back(queueCreateInfo);
         }
+		vk::PhysicalDeviceFeatures supportedFeatures = this->_physicalDevice.getFeatures();
 		vk::PhysicalDeviceFeatures deviceFeatures;
         deviceFeatures.fillModeNonSolid = VK_TRUE;
-		vk::DeviceCreateInfo createInfo(vk::DeviceCreateFlags(), static_cast<uint32_t>(queueCreateInfos.size()), queueCreateInfos.data(), 0, nullptr, static_cast<uint32_t>(gDeviceExtensions.size()), gDeviceExtensions.data(), &deviceFeatures);
+        // The feature guarantees sampling and filtering of every BC format with optimal tiling
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        Texture::setBlockCompression(supportedFeatures.textureCompressionBC == VK_TRUE);
+        Texture::setStreaming(gTextureStreaming);
+        if (!supportedFeatures.textureCompressionBC)
+            LOG(WARNING) << "Renderer: BC formats unsupported, textures are uploaded uncompressed";
+        std::vector<const char *> deviceExtensions(gDeviceExtensions);
+        // The texture array of the material table is indexed by a push constant
+        this->_bindless = gBindless && supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = this->_bindless ? VK_TRUE : VK_FALSE;
+#ifdef VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+        // Partially bound and update after bind sampled images are required by the extension, no need to query them
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        this->_descriptorIndexing = this->_bindless && this->isDeviceExtensionAvailable(VK_KHR_MAINTENANCE3_EXTENSION_NAME) && this->isDeviceExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        if (this->_descriptorIndexing)
+        {
+            deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+#endif
+        if (gBindless && !this->_bindless)
+            LOG(WARNING) << "Renderer: dynamic indexing of sampler arrays unsupported, bindless materials disabled";
+		vk::DeviceCreateInfo createInfo(vk::DeviceCreateFlags(), static_cast<uint32_t>(queueCreateInfos.size()), queueCreateInfos.data(), 0, nullptr, static_cast<uint32_t>(deviceExtensions.size()), deviceExtensions.data(), &deviceFeatures);
+#ifdef VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
+        if (this->_descriptorIndexing)
+            createInfo.setPNext(&indexingFeatures);
+#endif
 		if (gEnableValidationLayers)
 		{
 			createInfo.enabledLayerCount = static_cast<uint32_t>(gValidationLayers.size());
@@ -235,8 +331,10 @@ namespace Dwarf
 			createInfo.pQueueFamilyIndices = queueFamilyIndices;
 		}
 		vk::SwapchainKHR newSwapChain = this->_device.createSwapchainKHR(createInfo, CUSTOM_ALLOCATOR);
-		if (this->_swapChain)
-			this->_device.destroySwapchainKHR(this->_swapChain, CUSTOM_ALLOCATOR);
+		// The old one is retired by the creation, it goes away after the next present
+		if (this->_retiredSwapChain)
+			this->_device.destroySwapchainKHR(this->_retiredSwapChain, CUSTOM_ALLOCATOR);
+		this->_retiredSwapChain = oldSwapChain;
 		this->_swapChain = newSwapChain;
 		this->_swapChainImages = this->_device.getSwapchainImagesKHR(this->_swapChain);
 		this->_swapChainImageFormat = surfaceFormat.format;
@@ -256,17 +354,34 @@ namespace Dwarf
 
 	void Renderer::createRenderPass()
 	{
-		vk::AttachmentDescription colorAttachment(vk::AttachmentDescriptionFlags(), this->_swapChainImageFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR);
-		vk::AttachmentDescription depthAttachment(vk::AttachmentDescriptionFlags(), this->findDepthFormat(), vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+		// First pass: clears and keeps the depth for the depth pyramid
+		vk::AttachmentDescription colorAttachment(vk::AttachmentDescriptionFlags(), this->_swapChainImageFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal);
+		vk::AttachmentDescription depthAttachment(vk::AttachmentDescriptionFlags(), this->findDepthFormat(), vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
 		vk::AttachmentReference colorAttachmentRef(0, vk::ImageLayout::eColorAttachmentOptimal);
 		vk::AttachmentReference depthAttachmentRef(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
 		vk::SubpassDescription subPass(vk::SubpassDescriptionFlags(), vk::PipelineBindPoint::eGraphics, 0, nullptr, 1, &colorAttachmentRef, nullptr, &depthAttachmentRef);
-		vk::SubpassDependency dependency(VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eBottomOfPipe, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eMemoryRead, vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+		std::array<vk::SubpassDependency, 2> dependencies =
+		{
+			vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eBottomOfPipe, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eMemoryRead, vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite),
+			vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL, vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::AccessFlagBits::eShaderRead)
+		};
 		std::array<vk::AttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-		vk::RenderPassCreateInfo renderPassInfo(vk::RenderPassCreateFlags(), static_cast<uint32_t>(attachments.size()), attachments.data(), 1, &subPass, 1, &dependency);
+		vk::RenderPassCreateInfo renderPassInfo(vk::RenderPassCreateFlags(), static_cast<uint32_t>(attachments.size()), attachments.data(), 1, &subPass, static_cast<uint32_t>(dependencies.size()), dependencies.data());
 		if (this->_renderPass)
 			this->_device.destroyRenderPass(this->_renderPass, CUSTOM_ALLOCATOR);
 		this->_renderPass = this->_device.createRenderPass(renderPassInfo, CUSTOM_ALLOCATOR);
+
+		// Second pass: draws what the late culling phase found, compatible with the first one
+		attachments.at(0).setLoadOp(vk::AttachmentLoadOp::eLoad).setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal).setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+		attachments.at(1).setLoadOp(vk::AttachmentLoadOp::eLoad).setStoreOp(vk::AttachmentStoreOp::eDontCare).setInitialLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal).setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+		dependencies =
+		{
+			vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite),
+			vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0, vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests, vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+		};
+		if (this->_renderPassLoad)
+			this->_device.destroyRenderPass(this->_renderPassLoad, CUSTOM_ALLOCATOR);
+		this->_renderPassLoad = this->_device.createRenderPass(renderPassInfo, CUSTOM_ALLOCATOR);
 	}
 
 	void Renderer::createCommandPool()
@@ -288,9 +403,10 @@ namespace Dwarf
 			this->_device.freeMemory(this->_depthImageMemory, CUSTOM_ALLOCATOR);
 		if (this->_depthImage)
 			this->_device.destroyImage(this->_depthImage, CUSTOM_ALLOCATOR);
-		Tools::createImage(this->_device, this->_physicalDevice.getMemoryProperties(), this->_swapChainExtent.width, this->_swapChainExtent.height, depthFormat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_depthImage, this->_depthImageMemory);
+		Tools::createImage(this->_device, this->_physicalDevice.getMemoryProperties(), this->_swapChainExtent.width, this->_swapChainExtent.height, depthFormat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_depthImage, this->_depthImageMemory);
 		Tools::createImageView(this->_device, this->_depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth, this->_depthImageView);
 		Tools::transitionImageLayout(this->_device, this->_graphicsQueue, this->_commandPool, this->_depthImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+		this->_cullingManager->createDepthPyramid(this->_depthImageView, this->_swapChainExtent);
 	}
 
 	void Renderer::createFramebuffers()
@@ -326,13 +442,13 @@ namespace Dwarf
 			vk::CommandBufferAllocateInfo allocInfo(this->_commandPool, vk::CommandBufferLevel::ePrimary, static_cast<uint32_t>(this->_commandBuffers.size()));
 			this->_commandBuffers = this->_device.allocateCommandBuffers(allocInfo);
 		}
-        this->_commandBufferBuilder->createCommandBuffers(this->_graphicsQueue, this->_physicalDevice.getMemoryProperties());
+        this->_commandBufferBuilder->createCommandBuffers();
 		this->buildCommandBuffers();
 	}
 
 	void Renderer::buildCommandBuffers()
 	{
-        this->_commandBufferBuilder->buildCommandBuffers(this->_commandBuffers, this->_camera.getMVP());
+        this->_commandBufferBuilder->buildCommandBuffers(this->_commandBuffers, this->_camera.getMVP(), *this->_cullingManager);
 	}
 
 	void Renderer::createSemaphores()
@@ -347,7 +463,9 @@ namespace Dwarf
         vk::ResultValue<uint32_t> imageIndex = this->_device.acquireNextImageKHR(this->_swapChain, std::numeric_limits<uint64_t>::max(), this->_imageAvailableSemaphore, VK_NULL_HANDLE);
 		if (imageIndex.result == vk::Result::eErrorOutOfDateKHR)
 		{
-			this->recreateSwapChain();
+			// Nothing was submitted, the transient sets of the frame can go already
+			this->_descriptorAllocator->beginFrame();
+			this->_resizePending = true;
 			return;
 		}
 		else if (imageIndex.result != vk::Result::eSuccess && imageIndex.result != vk::Result::eSuboptimalKHR)
@@ -358,10 +476,17 @@ namespace Dwarf
 		vk::PresentInfoKHR presentInfo(1, &this->_renderFinishedSemaphore, 1, &this->_swapChain, &imageIndex.value, nullptr);
 		vk::Result result = this->_presentQueue.presentKHR(presentInfo);
 		if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
-			this->recreateSwapChain();
+			this->_resizePending = true;
 		else if (result != vk::Result::eSuccess)
 			Tools::exitOnResult(result);
 		this->_presentQueue.waitIdle();
+		// The frame is complete, its transient descriptor sets are reset in bulk
+		this->_descriptorAllocator->beginFrame();
+		if (this->_retiredSwapChain)
+		{
+			this->_device.destroySwapchainKHR(this->_retiredSwapChain, CUSTOM_ALLOCATOR);
+			this->_retiredSwapChain = vk::SwapchainKHR();
+		}
 	}
 
 	void Renderer::setupDebugCallback()
@@ -403,7 +528,7 @@ namespace Dwarf
 		vk::Bool32 presentSupport;
         for (const auto &queueFamily : queueFamilies)
         {
-            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & vk::QueueFlagBits::eGraphics && queueFamily.queueFlags & vk::QueueFlagBits::eCompute)
             {
                 indices.graphicsFamily = i;
                 indices.graphicsFamilySet = true;
@@ -431,6 +556,18 @@ namespace Dwarf
 		return (requiredExtensions.empty());
 	}
 
+    bool Renderer::isDeviceExtensionAvailable(const char *extensionName) const
+    {
+        std::vector<vk::ExtensionProperties> availableExtensions = this->_physicalDevice.enumerateDeviceExtensionProperties(CUSTOM_ALLOCATOR);
+
+        for (const auto &extension : availableExtensions)
+        {
+            if (std::string(extension.extensionName) == extensionName)
+                return (true);
+        }
+        return (false);
+    }
+
 	Renderer::SwapChainSupportDetails Renderer::querySwapChainSupport(const vk::PhysicalDevice &device) const
 	{
 		Renderer::SwapChainSupportDetails details;
@@ -474,7 +611,7 @@ namespace Dwarf
 			return (capabilities.currentExtent);
 		else
 		{
-			vk::Extent2D actualExtent(1280, 720);
+			vk::Extent2D actualExtent = this->_pendingExtent;
 			actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
 			actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
 			return (actualExtent);
@@ -483,7 +620,7 @@ namespace Dwarf
 
 	vk::Format Renderer::findDepthFormat() const
 	{
-		return (this->findSupportedFormat({ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint }, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment));
+		return (this->findSupportedFormat({ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint }, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage));
 	}
 
 	vk::Format Renderer::findSupportedFormat(const std::vector<vk::Format> &candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features) const
@@ -528,11 +665,19 @@ namespace Dwarf
 
 	void Renderer::recreateSwapChain()
 	{
-		this->_device.waitIdle();
+		vk::Format previousFormat = this->_swapChainImageFormat;
+
+		// No device wide wait: drawFrame waits for the present queue, so the previous frame is complete
+		this->_resizePending = false;
+        this->_materialManager->waitPipelines();
 		this->createSwapChain();
 		this->createImageViews();
-		this->createRenderPass();
-        this->_materialManager->recreatePipelines();
+		// Viewport and scissor are dynamic, the render passes and pipelines only depend on the formats
+		if (this->_swapChainImageFormat != previousFormat)
+		{
+			this->createRenderPass();
+			this->_materialManager->recreatePipelines();
+		}
 		this->createDepthResources();
 		this->createFramebuffers();
 		this->createCommandBuffers();
@@ -540,10 +685,10 @@ namespace Dwarf
 
 	void Renderer::onWindowResized(GLFWwindow *window, int width, int height)
 	{
-		if (width == 0 || height == 0)
-			return;
 		Renderer *renderer = reinterpret_cast<Renderer *>(glfwGetWindowUserPointer(window));
-		renderer->recreateSwapChain();
+		// Only the last size of a drag matters, the swap chain is recreated before the next frame
+		renderer->_pendingExtent = vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		renderer->_resizePending = true;
 	}
 
 	void Renderer::onCursorMovement(GLFWwindow *window, double x, double y)
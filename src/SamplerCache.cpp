@@ -0,0 +1,40 @@
+#include "SamplerCache.h"
+
+namespace Dwarf
+{
+    SamplerCache::SamplerCache(const vk::Device &device, bool immutableSamplers)
+        : _device(device), _immutableSamplers(immutableSamplers), _requestCount(0)
+    {
+    }
+
+    SamplerCache::~SamplerCache()
+    {
+        for (const auto &sampler : this->_samplers)
+            this->_device.destroySampler(sampler.second, CUSTOM_ALLOCATOR);
+    }
+
+    const vk::Sampler &SamplerCache::getSampler(const vk::SamplerCreateInfo &samplerInfo)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        vk::SamplerCreateInfo key(samplerInfo);
+
+        key.setPNext(nullptr);
+        ++this->_requestCount;
+        auto sampler = this->_samplers.find(key);
+        if (sampler != this->_samplers.end())
+            return (sampler->second);
+        return (this->_samplers[key] = this->_device.createSampler(samplerInfo, CUSTOM_ALLOCATOR));
+    }
+
+    const vk::Sampler *SamplerCache::getImmutableSampler(const vk::SamplerCreateInfo &samplerInfo)
+    {
+        if (!this->_immutableSamplers)
+            return (nullptr);
+        return (&this->getSampler(samplerInfo));
+    }
+
+    void SamplerCache::logStatistics() const
+    {
+        LOG(INFO) << "SamplerCache: " << this->_samplers.size() << " samplers for " << this->_requestCount << " requests" << (this->_immutableSamplers ? ", immutable in the material layouts" : "");
+    }
+}
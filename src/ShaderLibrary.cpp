@@ -0,0 +1,27 @@
+#include "ShaderLibrary.h"
+
+namespace Dwarf
+{
+    ShaderLibrary::ShaderLibrary(const vk::Device &device)
+        : _device(device)
+    {
+    }
+
+    ShaderLibrary::~ShaderLibrary()
+    {
+        for (const auto &module : this->_modules)
+            this->_device.destroyShaderModule(module.second, CUSTOM_ALLOCATOR);
+    }
+
+    const vk::ShaderModule &ShaderLibrary::getModule(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto it = this->_modules.find(path);
+        if (it != this->_modules.end())
+            return (it->second);
+        std::vector<char> shaderCode = Tools::readFile(path);
+        vk::ShaderModule module = this->_device.createShaderModule(vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(), shaderCode.size(), reinterpret_cast<uint32_t *>(shaderCode.data())), CUSTOM_ALLOCATOR);
+        LOG(INFO) << "ShaderLibrary: loaded " << path;
+        return (this->_modules.insert(std::make_pair(path, module)).first->second);
+    }
+}
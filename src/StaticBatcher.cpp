@@ -0,0 +1,85 @@
+#include "StaticBatcher.h"
+
+#include <cmath>
+
+namespace Dwarf
+{
+    StaticBatcher::StaticBatcher(const vk::Device &device, const vk::DescriptorBufferInfo &lightBufferInfo, float chunkSize)
+        : _device(device), _lightBufferInfo(lightBufferInfo), _chunkSize(chunkSize)
+    {
+    }
+
+    StaticBatcher::~StaticBatcher()
+    {
+    }
+
+    void StaticBatcher::batch(std::vector<Mesh *> &meshes) const
+    {
+        std::map<BatchKey, Batch> batches;
+        std::vector<Mesh *> dynamicMeshes;
+        size_t submeshCount = 0;
+
+        for (auto &mesh : meshes)
+        {
+            if (!mesh->isStatic())
+            {
+                dynamicMeshes.push_back(mesh);
+                continue;
+            }
+            for (const auto &submesh : mesh->getSubmeshes())
+            {
+                if (submesh.getVerticesCount() == 0 || submesh.getIndicesCount() == 0)
+                    continue;
+                const glm::mat4 &transform = submesh.getTransform();
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+                const std::vector<Vertex> &vertices = submesh.getVertices();
+                const std::vector<uint32_t> &indices = submesh.getIndices();
+                // Only the finest level, the batches get their own levels of detail
+                uint32_t indexCount = submesh.getLods().front().indexCount;
+                std::vector<Vertex> worldVertices(vertices.size());
+                size_t v = 0;
+                for (const auto &vertex : vertices)
+                {
+                    worldVertices.at(v) = Vertex(glm::vec3(transform * glm::vec4(vertex.pos, 1.0f)), glm::normalize(normalMatrix * vertex.normal), vertex.uv);
+                    ++v;
+                }
+                for (uint32_t t = 0; t + 2 < indexCount; t += 3)
+                {
+                    glm::vec3 centroid = (worldVertices.at(indices.at(t)).pos + worldVertices.at(indices.at(t + 1)).pos + worldVertices.at(indices.at(t + 2)).pos) / 3.0f;
+                    auto it = batches.insert(std::make_pair(this->getKey(submesh.getMaterial(), centroid), Batch())).first;
+                    Batch &batch = it->second;
+                    if (batch.source != submeshCount + 1)
+                    {
+                        batch.source = submeshCount + 1;
+                        batch.remap.clear();
+                    }
+                    for (uint32_t e = 0; e < 3; ++e)
+                    {
+                        uint32_t index = indices.at(t + e);
+                        auto inserted = batch.remap.insert(std::make_pair(index, static_cast<uint32_t>(batch.vertices.size())));
+                        if (inserted.second)
+                            batch.vertices.push_back(worldVertices.at(index));
+                        batch.indices.push_back(inserted.first->second);
+                    }
+                }
+                ++submeshCount;
+            }
+            delete (mesh);
+        }
+        meshes.swap(dynamicMeshes);
+        if (batches.empty())
+            return;
+        Mesh *batchMesh = new Mesh(this->_device, this->_lightBufferInfo);
+        batchMesh->setStatic(true);
+        for (const auto &batch : batches)
+            batchMesh->addSubmesh(std::get<0>(batch.first), batch.second.vertices, batch.second.indices);
+        meshes.push_back(batchMesh);
+        LOG(INFO) << "StaticBatcher: " << submeshCount << " static submeshes merged in " << batches.size() << " batches";
+    }
+
+    StaticBatcher::BatchKey StaticBatcher::getKey(Material *material, const glm::vec3 &position) const
+    {
+        glm::vec3 cell = glm::floor(position / this->_chunkSize);
+        return (BatchKey(material, static_cast<int>(cell.x), static_cast<int>(cell.y), static_cast<int>(cell.z)));
+    }
+}
@@ -1,9 +1,12 @@
 #include "Submesh.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
 
 namespace Dwarf
 {
     Submesh::Submesh(Material *material, const glm::mat4 &transformMatrix, const vk::DescriptorBufferInfo &lightBufferInfo)
-        : _lightBufferInfo(lightBufferInfo), _material(material), _transform(transformMatrix)
+        : _lightBufferInfo(lightBufferInfo), _material(material), _transform(transformMatrix), _drawCommandOffset(0), _meshletIndexOffset(0), _meshletDrawCommandOffset(0), _boundingSphere(0.0f)
     {
     }
 
@@ -19,6 +22,12 @@ namespace Dwarf
 
     void Submesh::createBuffers(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::PhysicalDeviceMemoryProperties &memProperties)
     {
+        // The parameters live in the material table
+        if (this->_material->isBindless())
+        {
+            this->_material->buildDescriptorSet(vk::Buffer(), 0, memProperties, this->_lightBufferInfo);
+            return;
+        }
         vk::DeviceSize uniformBufferSize = sizeof(MaterialUniformBuffer);
         vk::BufferCreateInfo bufferInfo;
         bufferInfo.setSize(uniformBufferSize);
@@ -67,44 +76,132 @@ namespace Dwarf
         this->_material->buildDescriptorSet(this->_uniformBuffer, this->_uniformBufferOffset, memProperties, this->_lightBufferInfo);
     }
 
-    void Submesh::buildCommandBuffer(const vk::CommandBufferInheritanceInfo &inheritanceInfo, const glm::mat4 &mvp, const vk::Extent2D &extent) const
+    void Submesh::enqueue(RenderQueue &renderQueue, const glm::mat4 &mvp)
     {
-        this->_commandBuffer.reset(vk::CommandBufferResetFlags());
-        vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse, &inheritanceInfo);
-        this->_commandBuffer.begin(beginInfo);
-        this->_commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
-        this->_commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
-        this->_commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, this->_material->getPipeline());
+        glm::vec4 center = this->_transform * glm::vec4(glm::vec3(this->_boundingSphere), 1.0f);
+        DrawPass pass = this->_material->getUniformBuffer().d < 1.0f ? DRAW_TRANSPARENT : DRAW_OPAQUE;
+        // The clip w of a perspective projection is the view depth
+        float depth = (mvp * center).w;
+        renderQueue.push(RenderQueue::makeKey(pass, renderQueue.getPipelineID(this->_material->getPipeline()), static_cast<uint32_t>(this->_material->getID()), depth), this);
+    }
+
+    void Submesh::recordDraw(const vk::CommandBuffer &commandBuffer, const glm::mat4 &mvp, DrawState &state) const
+    {
+        const vk::PipelineLayout &pipelineLayout = this->_material->getPipelineLayout();
+        // Read once, the pipeline may become ready on a compile worker meanwhile
+        vk::Pipeline pipeline = this->_material->getPipeline();
+        if (state.pipeline != pipeline)
+        {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            state.pipeline = pipeline;
+        }
+        if (state.pipelineLayout != pipelineLayout || state.descriptorSet != this->_material->getDescriptorSet())
+        {
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, this->_material->getDescriptorSet(), nullptr);
+            state.pipelineLayout = pipelineLayout;
+            state.descriptorSet = this->_material->getDescriptorSet();
+        }
 
         std::array<glm::mat4, 2> tmp = { mvp, this->_transform };
-        this->_commandBuffer.pushConstants<glm::mat4>(this->_material->getPipelineLayout(), vk::ShaderStageFlagBits::eVertex, 0, tmp);
+        commandBuffer.pushConstants<glm::mat4>(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, tmp);
+        if (this->_material->isBindless())
+        {
+            uint32_t tableIndex = this->_material->getTableIndex();
+            commandBuffer.pushConstants<uint32_t>(pipelineLayout, vk::ShaderStageFlagBits::eFragment, sizeof(glm::mat4) * 2, tableIndex);
+        }
 
-        this->_commandBuffer.bindVertexBuffers(0, this->_buffer, this->_vertexBufferOffset);
-        this->_commandBuffer.bindIndexBuffer(this->_buffer, this->_indexBufferOffset, vk::IndexType::eUint32);
-        this->_commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->_material->getPipelineLayout(), 0, this->_material->getDescriptorSet(), nullptr);
-        this->_commandBuffer.drawIndexed(static_cast<uint32_t>(this->_indices.size()), 1, 0, 0, 0);
-        this->_commandBuffer.end();
+        if (state.vertexBuffer != this->_buffer || state.vertexBufferOffset != this->_vertexBufferOffset)
+        {
+            commandBuffer.bindVertexBuffers(0, this->_buffer, this->_vertexBufferOffset);
+            state.vertexBuffer = this->_buffer;
+            state.vertexBufferOffset = this->_vertexBufferOffset;
+        }
+        auto bindIndexBuffer = [&](const vk::Buffer &buffer, const vk::DeviceSize &offset)
+        {
+            if (state.indexBuffer == buffer && state.indexBufferOffset == offset)
+                return;
+            commandBuffer.bindIndexBuffer(buffer, offset, vk::IndexType::eUint32);
+            state.indexBuffer = buffer;
+            state.indexBufferOffset = offset;
+        };
+        bindIndexBuffer(this->_buffer, this->_indexBufferOffset);
+        if (this->_drawCommandBuffer)
+        {
+            commandBuffer.drawIndexedIndirect(this->_drawCommandBuffer, this->_drawCommandOffset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+            if (this->_meshletIndexBuffer)
+            {
+                bindIndexBuffer(this->_meshletIndexBuffer, this->_meshletIndexOffset);
+                commandBuffer.drawIndexedIndirect(this->_drawCommandBuffer, this->_meshletDrawCommandOffset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+            }
+        }
+        else
+            commandBuffer.drawIndexed(this->_lods.front().indexCount, 1, 0, 0, 0);
     }
 
     void Submesh::setCommandPool(vk::CommandPool *commandPool)
     {
         this->_commandPool = commandPool;
-        this->_material->setCommandPool(commandPool);
-    }
-
-    void Submesh::setCommandBuffer(vk::CommandBuffer commandBuffer)
-    {
-        this->_commandBuffer = commandBuffer;
     }
 
     void Submesh::setVertices(const std::vector<Vertex> &vertices)
     {
         this->_vertices = vertices;
+        if (this->_vertices.empty())
+            return;
+        glm::vec3 minimum = this->_vertices.front().pos;
+        glm::vec3 maximum = this->_vertices.front().pos;
+        for (const auto &vertex : this->_vertices)
+        {
+            minimum = glm::min(minimum, vertex.pos);
+            maximum = glm::max(maximum, vertex.pos);
+        }
+        glm::vec3 center = (minimum + maximum) * 0.5f;
+        float radius = 0.0f;
+        for (const auto &vertex : this->_vertices)
+            radius = std::max(radius, glm::length(vertex.pos - center));
+        this->_boundingSphere = glm::vec4(center, radius);
     }
 
     void Submesh::setIndices(const std::vector<uint32_t> &indices)
     {
         this->_indices = indices;
+        this->_lods.clear();
+        this->_lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+    }
+
+    void Submesh::buildMeshlets()
+    {
+        if (this->_lods.size() != 1 || this->_indices.size() <= DWARF_MESHLET_MAX_TRIANGLES * 3)
+            return;
+        MeshletBuilder builder(this->_vertices);
+        builder.build(this->_indices, this->_meshlets);
+        LOG(INFO) << "Submesh: " << this->_meshlets.size() << " meshlets for " << this->_indices.size() / 3 << " triangles";
+    }
+
+    void Submesh::generateLods()
+    {
+        if (this->_vertices.empty() || this->_lods.size() != 1)
+            return;
+        MeshSimplifier simplifier(this->_vertices);
+        std::vector<uint32_t> previous(this->_indices);
+        std::vector<uint32_t> simplified;
+        size_t targetIndexCount;
+        float error = 0.0f;
+
+        while (this->_lods.size() < DWARF_MAX_LODS)
+        {
+            targetIndexCount = previous.size() / 6 * 3;
+            if (targetIndexCount < DWARF_MIN_LOD_TRIANGLES * 3)
+                break;
+            error = std::max(error, simplifier.simplify(previous, targetIndexCount, simplified));
+            // Mostly borders and seams left, another level would not be worth its memory
+            if (simplified.size() * 10 > previous.size() * 9)
+                break;
+            this->_lods.push_back({ static_cast<uint32_t>(this->_indices.size()), static_cast<uint32_t>(simplified.size()), error });
+            this->_indices.insert(this->_indices.end(), simplified.begin(), simplified.end());
+            previous.swap(simplified);
+        }
+        LOG(INFO) << "Submesh: " << this->_lods.size() << " levels of detail, " << this->_lods.back().indexCount / 3 << " triangles for the coarsest";
     }
 
     size_t Submesh::getVerticesCount() const
@@ -127,6 +224,16 @@ namespace Dwarf
         return (this->_indices);
     }
 
+    const std::vector<SubmeshLod> &Submesh::getLods() const
+    {
+        return (this->_lods);
+    }
+
+    const std::vector<Meshlet> &Submesh::getMeshlets() const
+    {
+        return (this->_meshlets);
+    }
+
     void Submesh::setBuffer(const vk::Buffer &buffer)
     {
         this->_buffer = buffer;
@@ -142,9 +249,41 @@ namespace Dwarf
         this->_indexBufferOffset = indexBufferOffset;
     }
 
-    vk::CommandBuffer Submesh::getCommandBuffer() const
+    void Submesh::setDrawCommandBuffer(const vk::Buffer &drawCommandBuffer, const vk::DeviceSize &drawCommandOffset)
     {
-        return (this->_commandBuffer);
+        this->_drawCommandBuffer = drawCommandBuffer;
+        this->_drawCommandOffset = drawCommandOffset;
     }
 
+    void Submesh::setMeshletDraw(const vk::Buffer &meshletIndexBuffer, const vk::DeviceSize &meshletIndexOffset, const vk::DeviceSize &drawCommandOffset)
+    {
+        this->_meshletIndexBuffer = meshletIndexBuffer;
+        this->_meshletIndexOffset = meshletIndexOffset;
+        this->_meshletDrawCommandOffset = drawCommandOffset;
+    }
+
+    const vk::Buffer &Submesh::getBuffer() const
+    {
+        return (this->_buffer);
+    }
+
+    const vk::DeviceSize &Submesh::getIndexBufferOffset() const
+    {
+        return (this->_indexBufferOffset);
+    }
+
+    const glm::vec4 &Submesh::getBoundingSphere() const
+    {
+        return (this->_boundingSphere);
+    }
+
+    const glm::mat4 &Submesh::getTransform() const
+    {
+        return (this->_transform);
+    }
+
+    Material *Submesh::getMaterial() const
+    {
+        return (this->_material);
+    }
 }
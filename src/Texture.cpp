@@ -1,58 +1,262 @@
 #include "Texture.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "TextureCooker.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 namespace Dwarf
 {
-	Texture::Texture(const vk::Device &device, vk::CommandPool *commandPool, const vk::Queue &graphicsQueue, const std::string textureName, vk::ImageLayout imageLayout)
-		: _device(device), _commandPool(commandPool), _graphicsQueue(graphicsQueue), _textureName(textureName), _textureImageLayout(imageLayout)
+	Texture::Texture(const vk::Device &device, TextureUploader &textureUploader, SamplerCache &samplerCache, const std::string textureName, vk::ImageLayout imageLayout)
+		: _device(device), _textureUploader(textureUploader), _samplerCache(samplerCache), _textureName(textureName), _textureImageLayout(imageLayout), _residentLevel(0), _source(nullptr), _array(nullptr), _layer(0), _contentHash(0)
 	{
 	}
 
 	Texture::~Texture()
 	{
-		this->_device.destroySampler(this->_textureSampler, CUSTOM_ALLOCATOR);
-		this->_device.destroyImageView(this->_textureImageView, CUSTOM_ALLOCATOR);
-		this->_device.freeMemory(this->_textureImageMemory, CUSTOM_ALLOCATOR);
-		this->_device.destroyImage(this->_textureImage, CUSTOM_ALLOCATOR);
+		this->destroyImage(this->_retiredImage, this->_retiredImageMemory, this->_retiredImageView);
+		this->destroyImage(this->_textureImage, this->_textureImageMemory, this->_textureImageView);
+	}
+
+	bool Texture::_blockCompression = false;
+	bool Texture::_streaming = false;
+
+	void Texture::load()
+	{
+		std::string path = "resources/textures/" + this->_textureName;
+
+		if (this->_source || this->_file.isLoaded() || this->_textureImage)
+			return;
+		if (TextureFile::isContainer(path))
+		{
+			if (!this->_file.load(path))
+				Tools::exitOnError("Failed to load texture " + this->_textureName + " file");
+			if (this->_file.isCompressed() && !Texture::_blockCompression)
+				Tools::exitOnError("Texture " + this->_textureName + " is block compressed but the device cannot sample BC formats");
+		}
+		// Images are cooked once next to their source, remove the .dds to cook them again
+		else if (Texture::_blockCompression && !this->_file.load(path + ".dds"))
+			this->cookTexture(path, this->_file);
+		if (!this->_file.isLoaded())
+			this->decodeTexture(path, this->_file);
+		// Streaming reads any level from the CPU copy, the mips of decoded images cannot come from blits
+		if (Texture::_streaming)
+			this->generateMipmaps();
+		uint32_t header[3] = { static_cast<uint32_t>(this->_file.getFormat()), this->_file.getWidth(), this->_file.getHeight() };
+		this->_contentHash = Tools::hash64(this->_file.getData().data(), this->_file.getData().size(), Tools::hash64(header, sizeof(header)));
 	}
 
 	vk::DescriptorImageInfo &Texture::createTexture(const vk::PhysicalDeviceMemoryProperties &memProperties)
+	{
+		if (this->_source)
+			return (this->_source->createTexture(memProperties));
+		// Materials shared by several submeshes ask again, the texture is created by the first one
+		if (this->_textureImage)
+			return (this->_imageInfo);
+		this->load();
+		this->uploadLevels(memProperties, Texture::_streaming ? this->getBaseLevel() : 0);
+		// Copied to the staging buffer, the decoded data is not needed anymore
+		if (!Texture::_streaming)
+			this->_file.reset(vk::Format::eUndefined, 0, 0);
+		this->_textureSampler = this->_samplerCache.getSampler(Texture::getSamplerInfo());
+
+		this->_imageInfo = vk::DescriptorImageInfo(this->_textureSampler, this->_textureImageView, this->_textureImageLayout);
+		return (this->_imageInfo);
+	}
+
+    const std::string &Texture::getName() const
+    {
+        return (this->_textureName);
+    }
+
+    uint64_t Texture::getContentHash() const
+    {
+        return (this->_contentHash);
+    }
+
+    void Texture::setSource(Texture *source)
+    {
+        this->_source = source;
+        this->_file.reset(vk::Format::eUndefined, 0, 0);
+    }
+
+    Texture *Texture::getSource() const
+    {
+        return (this->_source);
+    }
+
+    const TextureFile &Texture::getFile() const
+    {
+        return (this->_file);
+    }
+
+    void Texture::generateMipmaps()
+    {
+        TextureCooker::generateMipmaps(this->_file);
+    }
+
+    void Texture::setArray(TextureArray *textureArray, uint32_t layer)
+    {
+        this->_array = textureArray;
+        this->_layer = layer;
+        this->_file.reset(vk::Format::eUndefined, 0, 0);
+    }
+
+    TextureArray *Texture::getArray() const
+    {
+        return (this->_array);
+    }
+
+    uint32_t Texture::getLayer() const
+    {
+        return (this->_layer);
+    }
+
+    void Texture::addDescriptor(const vk::DescriptorSet &descriptorSet, uint32_t binding, uint32_t arrayElement)
+    {
+        if (this->_source)
+            return (this->_source->addDescriptor(descriptorSet, binding, arrayElement));
+        for (const auto &descriptor : this->_descriptors)
+        {
+            if (descriptor.descriptorSet == descriptorSet && descriptor.binding == binding && descriptor.arrayElement == arrayElement)
+                return;
+        }
+        this->_descriptors.push_back({ descriptorSet, binding, arrayElement });
+    }
+
+    uint32_t Texture::getLevelCount() const
+    {
+        return (static_cast<uint32_t>(this->_file.getLevels().size()));
+    }
+
+    uint32_t Texture::getResidentLevel() const
+    {
+        return (this->_residentLevel);
+    }
+
+    uint32_t Texture::getBaseLevel() const
+    {
+        uint32_t level = 0;
+
+        while (level + 1 < this->getLevelCount() && std::max(this->_file.getLevels().at(level).width, this->_file.getLevels().at(level).height) > DWARF_STREAMING_BASE_SIZE)
+            ++level;
+        return (level);
+    }
+
+    vk::DeviceSize Texture::getLevelsSize(uint32_t firstLevel) const
+    {
+        vk::DeviceSize size = 0;
+
+        for (uint32_t level = firstLevel; level < this->getLevelCount(); ++level)
+            size += this->_file.getLevels().at(level).size;
+        return (size);
+    }
+
+    uint32_t Texture::getFullWidth() const
+    {
+        return (this->_file.getWidth());
+    }
+
+    void Texture::stream(uint32_t firstLevel, const vk::PhysicalDeviceMemoryProperties &memProperties)
+    {
+        // A single stream at a time, the streamer commits before planning again
+        this->destroyImage(this->_retiredImage, this->_retiredImageMemory, this->_retiredImageView);
+        this->_retiredImage = this->_textureImage;
+        this->_retiredImageMemory = this->_textureImageMemory;
+        this->_retiredImageView = this->_textureImageView;
+        this->uploadLevels(memProperties, firstLevel);
+    }
+
+    void Texture::commitStream()
+    {
+        std::vector<vk::WriteDescriptorSet> descriptorWrites;
+
+        if (!this->_retiredImage)
+            return;
+        this->_imageInfo = vk::DescriptorImageInfo(this->_textureSampler, this->_textureImageView, this->_textureImageLayout);
+        for (const auto &descriptor : this->_descriptors)
+            descriptorWrites.push_back(vk::WriteDescriptorSet(descriptor.descriptorSet, descriptor.binding, descriptor.arrayElement, 1, vk::DescriptorType::eCombinedImageSampler, &this->_imageInfo));
+        this->_device.updateDescriptorSets(descriptorWrites, nullptr);
+        this->destroyImage(this->_retiredImage, this->_retiredImageMemory, this->_retiredImageView);
+    }
+
+    void Texture::setBlockCompression(bool blockCompression)
+    {
+        Texture::_blockCompression = blockCompression;
+    }
+
+    void Texture::setStreaming(bool streaming)
+    {
+        Texture::_streaming = streaming;
+    }
+
+    vk::SamplerCreateInfo Texture::getSamplerInfo()
+    {
+        // No upper LOD clamp, the image views bound the levels of each texture
+        return (vk::SamplerCreateInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, 0.0f, VK_TRUE, 16, VK_FALSE, vk::CompareOp::eAlways, 0.0f, 1000.0f, vk::BorderColor::eIntOpaqueBlack, VK_FALSE));
+    }
+
+	void Texture::decodeTexture(const std::string &path, TextureFile &file) const
 	{
 		int textureWidth;
 		int textureHeight;
 		int textureChannels;
-		stbi_uc *pixels = stbi_load(std::string("resources/textures/" + this->_textureName).c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+		stbi_uc *pixels = stbi_load(path.c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
 		if (!pixels)
 			Tools::exitOnError("Failed to load texture " + this->_textureName + "file");
-		this->_width = static_cast<uint32_t>(textureWidth);
-		this->_height = static_cast<uint32_t>(textureHeight);
-		vk::DeviceSize imageSize = this->_width * this->_height * STBI_rgb_alpha;
-		vk::Image stagingImage;
-		vk::DeviceMemory stagingImageMemory;
-		Tools::createImage(this->_device, memProperties, this->_width, this->_height, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eLinear, vk::ImageUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingImage, stagingImageMemory);
-		void *data = this->_device.mapMemory(stagingImageMemory, 0, imageSize);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		this->_device.unmapMemory(stagingImageMemory);
+		size_t size = static_cast<size_t>(textureWidth) * textureHeight * STBI_rgb_alpha;
+		file.reset(vk::Format::eR8G8B8A8Unorm, static_cast<uint32_t>(textureWidth), static_cast<uint32_t>(textureHeight));
+		file.addLevel(std::vector<unsigned char>(pixels, pixels + size), file.getWidth(), file.getHeight());
 		stbi_image_free(pixels);
-		Tools::createImage(this->_device, memProperties, this->_width, this->_height, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_textureImage, this->_textureImageMemory);
-		Tools::transitionImageLayout(this->_device, this->_graphicsQueue, *this->_commandPool, stagingImage, vk::ImageLayout::ePreinitialized, vk::ImageLayout::eTransferSrcOptimal);
-		Tools::transitionImageLayout(this->_device, this->_graphicsQueue, *this->_commandPool, this->_textureImage, vk::ImageLayout::ePreinitialized, vk::ImageLayout::eTransferDstOptimal);
-		Tools::copyImage(this->_device, this->_graphicsQueue, *this->_commandPool, stagingImage, this->_textureImage, this->_width, this->_height);
-		Tools::transitionImageLayout(this->_device, this->_graphicsQueue, *this->_commandPool, this->_textureImage, vk::ImageLayout::eTransferDstOptimal, this->_textureImageLayout);
-		this->_device.freeMemory(stagingImageMemory, CUSTOM_ALLOCATOR);
-		this->_device.destroyImage(stagingImage, CUSTOM_ALLOCATOR);
-		Tools::createImageView(this->_device, this->_textureImage, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, this->_textureImageView);
-		vk::SamplerCreateInfo samplerInfo(vk::SamplerCreateFlags(), vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, vk::SamplerAddressMode::eRepeat, 0.0f, VK_TRUE, 16, VK_FALSE, vk::CompareOp::eAlways, 0.0f, 0.0f, vk::BorderColor::eIntOpaqueBlack, VK_FALSE);
-		this->_textureSampler = this->_device.createSampler(samplerInfo, CUSTOM_ALLOCATOR);
+	}
 
-		this->_imageInfo = vk::DescriptorImageInfo(this->_textureSampler, this->_textureImageView, this->_textureImageLayout);
-		return (this->_imageInfo);
+	void Texture::cookTexture(const std::string &path, TextureFile &file) const
+	{
+		int textureWidth;
+		int textureHeight;
+		int textureChannels;
+		stbi_uc *pixels = stbi_load(path.c_str(), &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+		if (!pixels)
+			Tools::exitOnError("Failed to load texture " + this->_textureName + "file");
+		TextureCooker::cook(pixels, static_cast<uint32_t>(textureWidth), static_cast<uint32_t>(textureHeight), file);
+		stbi_image_free(pixels);
+		if (!file.saveDds(path + ".dds"))
+			LOG(WARNING) << "Texture: failed to save the cooked " << this->_textureName << ", it will be cooked again";
+		LOG(INFO) << "Texture: cooked " << this->_textureName << " to " << vk::to_string(file.getFormat());
 	}
 
-    void Texture::setCommandPool(vk::CommandPool *commandPool)
-    {
-        this->_commandPool = commandPool;
-    }
+	void Texture::uploadLevels(const vk::PhysicalDeviceMemoryProperties &memProperties, uint32_t firstLevel)
+	{
+		const std::vector<TextureLevel> &levels = this->_file.getLevels();
+		const TextureLevel &first = levels.at(firstLevel);
+		std::vector<vk::BufferImageCopy> regions;
+
+		this->_format = this->_file.getFormat();
+		this->_width = first.width;
+		this->_height = first.height;
+		this->_layerCount = 1;
+		this->_residentLevel = firstLevel;
+		// An uncompressed image without its mips gets them blitted, linear blits of R8G8B8A8 optimal images are mandatory
+		bool generateMipmaps = !this->_file.isCompressed() && levels.size() == 1;
+		this->_mipLevels = generateMipmaps ? static_cast<uint32_t>(std::floor(std::log2(std::max(this->_width, this->_height)))) + 1 : static_cast<uint32_t>(levels.size()) - firstLevel;
+		for (uint32_t level = firstLevel; level < levels.size(); ++level)
+			regions.push_back(vk::BufferImageCopy(levels.at(level).offset - first.offset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - firstLevel, 0, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(levels.at(level).width, levels.at(level).height, 1)));
+		// Transfer source as well, the levels may be blitted from one another
+		Tools::createImage(this->_device, memProperties, this->_width, this->_height, this->_format, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_textureImage, this->_textureImageMemory, this->_mipLevels);
+		this->_textureUploader.upload(this->_textureImage, this->_file.getData().data() + first.offset, this->_file.getData().size() - first.offset, regions, this->_mipLevels, this->_layerCount);
+		Tools::createImageView(this->_device, this->_textureImage, this->_format, vk::ImageAspectFlagBits::eColor, this->_textureImageView, 0, this->_mipLevels);
+	}
+
+	void Texture::destroyImage(vk::Image &image, vk::DeviceMemory &imageMemory, vk::ImageView &imageView) const
+	{
+		this->_device.destroyImageView(imageView, CUSTOM_ALLOCATOR);
+		this->_device.freeMemory(imageMemory, CUSTOM_ALLOCATOR);
+		this->_device.destroyImage(image, CUSTOM_ALLOCATOR);
+		imageView = vk::ImageView();
+		imageMemory = vk::DeviceMemory();
+		image = vk::Image();
+	}
 }
@@ -0,0 +1,50 @@
+#include "TextureArray.h"
+
+#include <cstring>
+
+namespace Dwarf
+{
+    TextureArray::TextureArray(const vk::Device &device, TextureUploader &textureUploader, const vk::Sampler &sampler)
+        : _device(device), _textureUploader(textureUploader), _sampler(sampler), _layerCount(0)
+    {
+    }
+
+    TextureArray::~TextureArray()
+    {
+        this->_device.destroyImageView(this->_imageView, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_imageMemory, CUSTOM_ALLOCATOR);
+        this->_device.destroyImage(this->_image, CUSTOM_ALLOCATOR);
+    }
+
+    void TextureArray::create(const std::vector<const TextureFile *> &files, const vk::PhysicalDeviceMemoryProperties &memProperties)
+    {
+        const TextureFile &first = *files.front();
+        const std::vector<TextureLevel> &levels = first.getLevels();
+        size_t layerSize = first.getData().size();
+        std::vector<unsigned char> data(layerSize * files.size());
+        std::vector<vk::BufferImageCopy> regions;
+
+        this->_layerCount = static_cast<uint32_t>(files.size());
+        // Layers back to back, each with its levels in the order of the files
+        for (uint32_t layer = 0; layer < this->_layerCount; ++layer)
+        {
+            memcpy(data.data() + layer * layerSize, files.at(layer)->getData().data(), layerSize);
+            for (uint32_t level = 0; level < levels.size(); ++level)
+                regions.push_back(vk::BufferImageCopy(layer * layerSize + levels.at(level).offset, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, layer, 1), vk::Offset3D(0, 0, 0), vk::Extent3D(levels.at(level).width, levels.at(level).height, 1)));
+        }
+        Tools::createImage(this->_device, memProperties, first.getWidth(), first.getHeight(), first.getFormat(), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, this->_image, this->_imageMemory, static_cast<uint32_t>(levels.size()), this->_layerCount);
+        this->_textureUploader.upload(this->_image, data.data(), data.size(), regions, static_cast<uint32_t>(levels.size()), this->_layerCount);
+        Tools::createImageView(this->_device, this->_image, first.getFormat(), vk::ImageAspectFlagBits::eColor, this->_imageView, 0, static_cast<uint32_t>(levels.size()), vk::ImageViewType::e2DArray, this->_layerCount);
+        this->_imageInfo = vk::DescriptorImageInfo(this->_sampler, this->_imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+
+    const vk::DescriptorImageInfo &TextureArray::getImageInfo() const
+    {
+        return (this->_imageInfo);
+    }
+
+    uint32_t TextureArray::getLayerCount() const
+    {
+        return (this->_layerCount);
+    }
+}
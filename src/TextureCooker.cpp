@@ -0,0 +1,224 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace Dwarf
+{
+    namespace TextureCooker
+    {
+        namespace
+        {
+            uint16_t toRgb565(const int *color)
+            {
+                return (static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3)));
+            }
+
+            void fromRgb565(uint16_t value, int *color)
+            {
+                int red = (value >> 11) & 31;
+                int green = (value >> 5) & 63;
+                int blue = value & 31;
+
+                color[0] = (red << 3) | (red >> 2);
+                color[1] = (green << 2) | (green >> 4);
+                color[2] = (blue << 3) | (blue >> 2);
+            }
+
+            // 4 colour mode of BC1, also the colour half of BC3
+            void encodeColor(const unsigned char *texels, unsigned char *output)
+            {
+                int minColor[3] = { 255, 255, 255 };
+                int maxColor[3] = { 0, 0, 0 };
+                int palette[4][3];
+                uint32_t indices = 0;
+
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        minColor[c] = std::min(minColor[c], static_cast<int>(texels[i * 4 + c]));
+                        maxColor[c] = std::max(maxColor[c], static_cast<int>(texels[i * 4 + c]));
+                    }
+                }
+                // The end points are rarely hit exactly, insetting the box lowers the error of the interpolated colours
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    int inset = (maxColor[c] - minColor[c]) >> 4;
+                    minColor[c] += inset;
+                    maxColor[c] -= inset;
+                }
+                uint16_t color0 = toRgb565(maxColor);
+                uint16_t color1 = toRgb565(minColor);
+                if (color0 < color1)
+                    std::swap(color0, color1);
+                if (color0 != color1)
+                {
+                    fromRgb565(color0, palette[0]);
+                    fromRgb565(color1, palette[1]);
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                    }
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        uint32_t best = 0;
+                        int bestDistance = INT32_MAX;
+                        for (uint32_t p = 0; p < 4; ++p)
+                        {
+                            int distance = 0;
+                            for (uint32_t c = 0; c < 3; ++c)
+                                distance += (texels[i * 4 + c] - palette[p][c]) * (texels[i * 4 + c] - palette[p][c]);
+                            if (distance < bestDistance)
+                            {
+                                bestDistance = distance;
+                                best = p;
+                            }
+                        }
+                        indices |= best << (i * 2);
+                    }
+                }
+                output[0] = static_cast<unsigned char>(color0 & 0xFF);
+                output[1] = static_cast<unsigned char>(color0 >> 8);
+                output[2] = static_cast<unsigned char>(color1 & 0xFF);
+                output[3] = static_cast<unsigned char>(color1 >> 8);
+                for (uint32_t b = 0; b < 4; ++b)
+                    output[4 + b] = static_cast<unsigned char>((indices >> (b * 8)) & 0xFF);
+            }
+
+            // 8 values mode of the BC3 alpha block
+            void encodeAlpha(const unsigned char *texels, unsigned char *output)
+            {
+                int minAlpha = 255;
+                int maxAlpha = 0;
+                int palette[8];
+                uint64_t indices = 0;
+
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    minAlpha = std::min(minAlpha, static_cast<int>(texels[i * 4 + 3]));
+                    maxAlpha = std::max(maxAlpha, static_cast<int>(texels[i * 4 + 3]));
+                }
+                if (maxAlpha != minAlpha)
+                {
+                    palette[0] = maxAlpha;
+                    palette[1] = minAlpha;
+                    for (int p = 2; p < 8; ++p)
+                        palette[p] = ((8 - p) * maxAlpha + (p - 1) * minAlpha) / 7;
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        uint64_t best = 0;
+                        int bestDistance = INT32_MAX;
+                        for (uint32_t p = 0; p < 8; ++p)
+                        {
+                            int distance = std::abs(texels[i * 4 + 3] - palette[p]);
+                            if (distance < bestDistance)
+                            {
+                                bestDistance = distance;
+                                best = p;
+                            }
+                        }
+                        indices |= best << (i * 3);
+                    }
+                }
+                output[0] = static_cast<unsigned char>(maxAlpha);
+                output[1] = static_cast<unsigned char>(minAlpha);
+                for (uint32_t b = 0; b < 6; ++b)
+                    output[2 + b] = static_cast<unsigned char>((indices >> (b * 8)) & 0xFF);
+            }
+
+            std::vector<unsigned char> encodeLevel(const std::vector<unsigned char> &pixels, uint32_t width, uint32_t height, vk::Format format)
+            {
+                std::vector<unsigned char> level(TextureFile::getLevelSize(format, width, height));
+                bool alpha = format == vk::Format::eBc3UnormBlock;
+                unsigned char texels[64];
+                unsigned char *output = level.data();
+
+                for (uint32_t blockY = 0; blockY < height; blockY += 4)
+                {
+                    for (uint32_t blockX = 0; blockX < width; blockX += 4)
+                    {
+                        // Blocks past the edge of small levels repeat the last row and column
+                        for (uint32_t i = 0; i < 16; ++i)
+                        {
+                            uint32_t x = std::min(blockX + i % 4, width - 1);
+                            uint32_t y = std::min(blockY + i / 4, height - 1);
+                            std::copy_n(pixels.data() + (static_cast<size_t>(y) * width + x) * 4, 4, texels + i * 4);
+                        }
+                        if (alpha)
+                        {
+                            encodeAlpha(texels, output);
+                            output += 8;
+                        }
+                        encodeColor(texels, output);
+                        output += 8;
+                    }
+                }
+                return (level);
+            }
+
+            std::vector<unsigned char> downsample(const std::vector<unsigned char> &pixels, uint32_t width, uint32_t height)
+            {
+                uint32_t halfWidth = std::max(1u, width / 2);
+                uint32_t halfHeight = std::max(1u, height / 2);
+                std::vector<unsigned char> level(static_cast<size_t>(halfWidth) * halfHeight * 4);
+
+                for (uint32_t y = 0; y < halfHeight; ++y)
+                {
+                    uint32_t y0 = std::min(y * 2, height - 1);
+                    uint32_t y1 = std::min(y * 2 + 1, height - 1);
+                    for (uint32_t x = 0; x < halfWidth; ++x)
+                    {
+                        uint32_t x0 = std::min(x * 2, width - 1);
+                        uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                        for (uint32_t c = 0; c < 4; ++c)
+                        {
+                            uint32_t sum = pixels[(static_cast<size_t>(y0) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y0) * width + x1) * 4 + c] + pixels[(static_cast<size_t>(y1) * width + x0) * 4 + c] + pixels[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                            level[(static_cast<size_t>(y) * halfWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                        }
+                    }
+                }
+                return (level);
+            }
+        }
+
+        void cook(const unsigned char *pixels, uint32_t width, uint32_t height, TextureFile &file)
+        {
+            size_t size = static_cast<size_t>(width) * height * 4;
+            std::vector<unsigned char> level(pixels, pixels + size);
+            bool opaque = true;
+
+            for (size_t i = 3; i < size && opaque; i += 4)
+                opaque = pixels[i] == 255;
+            vk::Format format = opaque ? vk::Format::eBc1RgbaUnormBlock : vk::Format::eBc3UnormBlock;
+            file.reset(format, width, height);
+            while (true)
+            {
+                file.addLevel(encodeLevel(level, width, height, format), width, height);
+                if (width == 1 && height == 1)
+                    break;
+                level = downsample(level, width, height);
+                width = std::max(1u, width / 2);
+                height = std::max(1u, height / 2);
+            }
+        }
+
+        void generateMipmaps(TextureFile &file)
+        {
+            if (file.isCompressed() || file.getLevels().size() != 1)
+                return;
+            uint32_t width = file.getWidth();
+            uint32_t height = file.getHeight();
+            std::vector<unsigned char> level(file.getData());
+            while (width > 1 || height > 1)
+            {
+                level = downsample(level, width, height);
+                width = std::max(1u, width / 2);
+                height = std::max(1u, height / 2);
+                file.addLevel(level, width, height);
+            }
+        }
+    }
+}
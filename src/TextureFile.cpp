@@ -0,0 +1,372 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FOURCC(a, b, c, d) (static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24))
+#define DDS_FLAGS_REQUIRED 0x1007 // caps, height, width, pixel format
+#define DDS_FLAG_MIPMAPCOUNT 0x20000
+#define DDS_FLAG_LINEARSIZE 0x80000
+#define DDS_PIXELFORMAT_FOURCC 0x4
+#define DDS_CAPS_TEXTURE 0x1000
+#define DDS_CAPS_COMPLEX_MIPMAP 0x400008
+
+namespace Dwarf
+{
+    namespace
+    {
+        struct DdsPixelFormat
+        {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t fourCC;
+            uint32_t rgbBitCount;
+            uint32_t masks[4];
+        };
+
+        struct DdsHeader
+        {
+            uint32_t size;
+            uint32_t flags;
+            uint32_t height;
+            uint32_t width;
+            uint32_t pitchOrLinearSize;
+            uint32_t depth;
+            uint32_t mipMapCount;
+            uint32_t reserved1[11];
+            DdsPixelFormat pixelFormat;
+            uint32_t caps[4];
+            uint32_t reserved2;
+        };
+
+        struct DdsHeaderDx10
+        {
+            uint32_t dxgiFormat;
+            uint32_t resourceDimension;
+            uint32_t miscFlag;
+            uint32_t arraySize;
+            uint32_t miscFlags2;
+        };
+
+        struct Ktx2Header
+        {
+            unsigned char identifier[12];
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+            uint64_t sgdByteOffset;
+            uint64_t sgdByteLength;
+        };
+
+        struct Ktx2Level
+        {
+            uint64_t byteOffset;
+            uint64_t byteLength;
+            uint64_t uncompressedByteLength;
+        };
+
+        const unsigned char gKtx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+        // DXGI_FORMAT values of the DX10 header
+        vk::Format getDxgiFormat(uint32_t dxgiFormat)
+        {
+            switch (dxgiFormat)
+            {
+            case 71: return (vk::Format::eBc1RgbaUnormBlock);
+            case 72: return (vk::Format::eBc1RgbaSrgbBlock);
+            case 77: return (vk::Format::eBc3UnormBlock);
+            case 78: return (vk::Format::eBc3SrgbBlock);
+            case 83: return (vk::Format::eBc5UnormBlock);
+            case 84: return (vk::Format::eBc5SnormBlock);
+            case 98: return (vk::Format::eBc7UnormBlock);
+            case 99: return (vk::Format::eBc7SrgbBlock);
+            default: return (vk::Format::eUndefined);
+            }
+        }
+
+        uint32_t getDxgiFormat(vk::Format format)
+        {
+            switch (format)
+            {
+            case vk::Format::eBc1RgbaUnormBlock: return (71);
+            case vk::Format::eBc1RgbaSrgbBlock: return (72);
+            case vk::Format::eBc3UnormBlock: return (77);
+            case vk::Format::eBc3SrgbBlock: return (78);
+            case vk::Format::eBc5UnormBlock: return (83);
+            case vk::Format::eBc5SnormBlock: return (84);
+            case vk::Format::eBc7UnormBlock: return (98);
+            case vk::Format::eBc7SrgbBlock: return (99);
+            default: return (0);
+            }
+        }
+
+        // Bytes per 4x4 block, 0 for the formats that are not block compressed
+        size_t getBlockSize(vk::Format format)
+        {
+            switch (format)
+            {
+            case vk::Format::eBc1RgbaUnormBlock:
+            case vk::Format::eBc1RgbaSrgbBlock:
+                return (8);
+            case vk::Format::eBc3UnormBlock:
+            case vk::Format::eBc3SrgbBlock:
+            case vk::Format::eBc5UnormBlock:
+            case vk::Format::eBc5SnormBlock:
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                return (16);
+            default:
+                return (0);
+            }
+        }
+    }
+
+    TextureFile::TextureFile()
+        : _format(vk::Format::eUndefined), _width(0), _height(0)
+    {
+    }
+
+    TextureFile::~TextureFile()
+    {
+    }
+
+    bool TextureFile::load(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+        this->reset(vk::Format::eUndefined, 0, 0);
+        if (!file.is_open())
+            return (false);
+        std::vector<char> content(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(content.data(), content.size());
+        bool loaded = false;
+        if (content.size() >= sizeof(uint32_t) + sizeof(DdsHeader) && *reinterpret_cast<const uint32_t *>(content.data()) == DDS_MAGIC)
+            loaded = this->loadDds(content);
+        else if (content.size() >= sizeof(Ktx2Header) && std::memcmp(content.data(), gKtx2Identifier, sizeof(gKtx2Identifier)) == 0)
+            loaded = this->loadKtx2(content);
+        if (!loaded)
+        {
+            LOG(WARNING) << "TextureFile: " << path << " is not a supported DDS or KTX2 file";
+            this->reset(vk::Format::eUndefined, 0, 0);
+        }
+        return (loaded);
+    }
+
+    bool TextureFile::saveDds(const std::string &path) const
+    {
+        uint32_t magic = DDS_MAGIC;
+        DdsHeader header = {};
+        DdsHeaderDx10 headerDx10 = {};
+
+        if (!this->isLoaded() || !this->isCompressed())
+            return (false);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return (false);
+        header.size = sizeof(DdsHeader);
+        header.flags = DDS_FLAGS_REQUIRED | DDS_FLAG_MIPMAPCOUNT | DDS_FLAG_LINEARSIZE;
+        header.height = this->_height;
+        header.width = this->_width;
+        header.pitchOrLinearSize = static_cast<uint32_t>(this->_levels.front().size);
+        header.mipMapCount = static_cast<uint32_t>(this->_levels.size());
+        header.pixelFormat.size = sizeof(DdsPixelFormat);
+        header.pixelFormat.flags = DDS_PIXELFORMAT_FOURCC;
+        header.pixelFormat.fourCC = DDS_FOURCC('D', 'X', '1', '0');
+        header.caps[0] = this->_levels.size() > 1 ? DDS_CAPS_TEXTURE | DDS_CAPS_COMPLEX_MIPMAP : DDS_CAPS_TEXTURE;
+        headerDx10.dxgiFormat = getDxgiFormat(this->_format);
+        headerDx10.resourceDimension = 3; // Texture 2D
+        headerDx10.arraySize = 1;
+        file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(&headerDx10), sizeof(headerDx10));
+        file.write(reinterpret_cast<const char *>(this->_data.data()), this->_data.size());
+        return (file.good());
+    }
+
+    void TextureFile::reset(vk::Format format, uint32_t width, uint32_t height)
+    {
+        this->_format = format;
+        this->_width = width;
+        this->_height = height;
+        this->_levels.clear();
+        this->_data.clear();
+    }
+
+    void TextureFile::addLevel(const std::vector<unsigned char> &data, uint32_t width, uint32_t height)
+    {
+        this->_levels.push_back({ width, height, this->_data.size(), data.size() });
+        this->_data.insert(this->_data.end(), data.begin(), data.end());
+    }
+
+    bool TextureFile::isLoaded() const
+    {
+        return (!this->_levels.empty());
+    }
+
+    bool TextureFile::isCompressed() const
+    {
+        return (getBlockSize(this->_format) != 0);
+    }
+
+    vk::Format TextureFile::getFormat() const
+    {
+        return (this->_format);
+    }
+
+    uint32_t TextureFile::getWidth() const
+    {
+        return (this->_width);
+    }
+
+    uint32_t TextureFile::getHeight() const
+    {
+        return (this->_height);
+    }
+
+    const std::vector<TextureLevel> &TextureFile::getLevels() const
+    {
+        return (this->_levels);
+    }
+
+    const std::vector<unsigned char> &TextureFile::getData() const
+    {
+        return (this->_data);
+    }
+
+    bool TextureFile::isContainer(const std::string &path)
+    {
+        std::string extension = path.substr(std::min(path.find_last_of('.'), path.size()));
+
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return (extension == ".dds" || extension == ".ktx2");
+    }
+
+    size_t TextureFile::getLevelSize(vk::Format format, uint32_t width, uint32_t height)
+    {
+        size_t blockSize = getBlockSize(format);
+
+        if (blockSize == 0)
+            return (static_cast<size_t>(width) * height * 4);
+        return (static_cast<size_t>(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * blockSize);
+    }
+
+    uint32_t TextureFile::getMipChainLength(uint32_t width, uint32_t height)
+    {
+        uint32_t length = 1;
+
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+            ++length;
+        return (length);
+    }
+
+    bool TextureFile::loadDds(const std::vector<char> &file)
+    {
+        DdsHeader header;
+        size_t offset = sizeof(uint32_t) + sizeof(DdsHeader);
+
+        std::memcpy(&header, file.data() + sizeof(uint32_t), sizeof(header));
+        if (header.size != sizeof(DdsHeader) || !(header.pixelFormat.flags & DDS_PIXELFORMAT_FOURCC))
+            return (false);
+        switch (header.pixelFormat.fourCC)
+        {
+        case DDS_FOURCC('D', 'X', 'T', '1'):
+            this->_format = vk::Format::eBc1RgbaUnormBlock;
+            break;
+        case DDS_FOURCC('D', 'X', 'T', '5'):
+            this->_format = vk::Format::eBc3UnormBlock;
+            break;
+        case DDS_FOURCC('A', 'T', 'I', '2'):
+        case DDS_FOURCC('B', 'C', '5', 'U'):
+            this->_format = vk::Format::eBc5UnormBlock;
+            break;
+        case DDS_FOURCC('D', 'X', '1', '0'):
+        {
+            DdsHeaderDx10 headerDx10;
+            if (file.size() < offset + sizeof(DdsHeaderDx10))
+                return (false);
+            std::memcpy(&headerDx10, file.data() + offset, sizeof(headerDx10));
+            offset += sizeof(DdsHeaderDx10);
+            // Arrays and cube maps are not handled
+            if (headerDx10.arraySize > 1)
+                return (false);
+            this->_format = getDxgiFormat(headerDx10.dxgiFormat);
+            break;
+        }
+        default:
+            return (false);
+        }
+        if (this->_format == vk::Format::eUndefined)
+            return (false);
+        this->_width = header.width;
+        this->_height = header.height;
+        if (this->_width == 0 || this->_height == 0)
+            return (false);
+        return (this->setLevels(file, offset, header.flags & DDS_FLAG_MIPMAPCOUNT ? std::min(std::max(header.mipMapCount, 1u), getMipChainLength(this->_width, this->_height)) : 1));
+    }
+
+    bool TextureFile::loadKtx2(const std::vector<char> &file)
+    {
+        Ktx2Header header;
+        Ktx2Level level;
+        uint32_t levelCount;
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        this->_format = static_cast<vk::Format>(header.vkFormat);
+        // Supercompressed (Basis, zstd), volume, array and cube textures are not handled
+        if (header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+            return (false);
+        if (getBlockSize(this->_format) == 0 && this->_format != vk::Format::eR8G8B8A8Unorm)
+            return (false);
+        this->_width = header.pixelWidth;
+        this->_height = header.pixelHeight;
+        if (this->_width == 0 || this->_height == 0)
+            return (false);
+        // Levels past the full chain are ignored, they would be shifted by 32 or more
+        levelCount = std::min(std::max(header.levelCount, 1u), getMipChainLength(this->_width, this->_height));
+        if (file.size() < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level))
+            return (false);
+        // The level index goes from the largest level, the data from the smallest one
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            std::memcpy(&level, file.data() + sizeof(Ktx2Header) + i * sizeof(Ktx2Level), sizeof(level));
+            uint32_t width = std::max(1u, this->_width >> i);
+            uint32_t height = std::max(1u, this->_height >> i);
+            // Both come from the file, their sum could wrap around
+            if (level.byteOffset > file.size() || level.byteLength > file.size() - level.byteOffset || level.byteLength < getLevelSize(this->_format, width, height))
+                return (false);
+            std::vector<unsigned char> data(file.begin() + static_cast<size_t>(level.byteOffset), file.begin() + static_cast<size_t>(level.byteOffset + getLevelSize(this->_format, width, height)));
+            this->addLevel(data, width, height);
+        }
+        return (true);
+    }
+
+    bool TextureFile::setLevels(const std::vector<char> &file, size_t offset, uint32_t levelCount)
+    {
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            uint32_t width = std::max(1u, this->_width >> i);
+            uint32_t height = std::max(1u, this->_height >> i);
+            size_t size = getLevelSize(this->_format, width, height);
+            if (offset > file.size() || size > file.size() - offset)
+                return (false);
+            this->_levels.push_back({ width, height, this->_data.size(), size });
+            this->_data.insert(this->_data.end(), file.begin() + offset, file.begin() + offset + size);
+            offset += size;
+        }
+        return (true);
+    }
+}
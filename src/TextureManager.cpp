@@ -0,0 +1,171 @@
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+
+namespace Dwarf
+{
+    TextureManager::TextureManager(const vk::Device &device, TextureUploader &textureUploader, SamplerCache &samplerCache)
+        : _device(device), _textureUploader(textureUploader), _samplerCache(samplerCache), _pathHits(0), _contentHits(0), _misses(0), _packedTextures(0)
+    {
+    }
+
+    TextureManager::~TextureManager()
+    {
+        if (!this->_references.empty())
+            LOG(WARNING) << "TextureManager: " << this->_references.size() << " textures still referenced at destruction";
+        for (const auto &reference : this->_references)
+            delete (reference.first);
+        for (auto &textureArray : this->_arrays)
+            delete (textureArray);
+    }
+
+    Texture *TextureManager::acquire(const std::string &textureName)
+    {
+        std::string path = TextureManager::resolvePath(textureName);
+        auto texture = this->_texturesPaths.find(path);
+
+        if (texture != this->_texturesPaths.end())
+        {
+            ++this->_pathHits;
+            ++this->_references.at(texture->second);
+            return (texture->second);
+        }
+        ++this->_misses;
+        Texture *newTexture = new Texture(this->_device, this->_textureUploader, this->_samplerCache, path);
+        this->_texturesPaths[path] = newTexture;
+        this->_references[newTexture] = 1;
+        return (newTexture);
+    }
+
+    void TextureManager::release(Texture *texture)
+    {
+        if (!texture)
+            return;
+        auto reference = this->_references.find(texture);
+        if (reference == this->_references.end())
+            Tools::exitOnError("TextureManager: release of a texture it does not own");
+        if (--reference->second > 0)
+            return;
+        this->_references.erase(reference);
+        this->_texturesPaths.erase(texture->getName());
+        auto hash = this->_texturesHashes.find(texture->getContentHash());
+        if (hash != this->_texturesHashes.end() && hash->second == texture)
+            this->_texturesHashes.erase(hash);
+        Texture *source = texture->getSource();
+        delete (texture);
+        // An alias holds a reference on the texture it forwards to
+        this->release(source);
+    }
+
+    void TextureManager::loadTextures(ThreadPool &threadPool, uint32_t threadCount)
+    {
+        std::vector<Texture *> textures;
+        std::atomic<size_t> nextTexture(0);
+
+        for (const auto &texture : this->_texturesPaths)
+        {
+            if (!texture.second->getSource())
+                textures.push_back(texture.second);
+        }
+        threadCount = std::max(std::min(threadCount, static_cast<uint32_t>(textures.size())), 1u);
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            threadPool.addJobThread(i, [&textures, &nextTexture]()
+            {
+                for (size_t texture = nextTexture++; texture < textures.size(); texture = nextTexture++)
+                    textures.at(texture)->load();
+            });
+        }
+        threadPool.wait();
+        for (const auto &texture : textures)
+        {
+            auto hash = this->_texturesHashes.find(texture->getContentHash());
+            if (hash == this->_texturesHashes.end())
+            {
+                this->_texturesHashes[texture->getContentHash()] = texture;
+                continue;
+            }
+            // A collision must not show the pixels of one texture on another, both stay separate
+            if (!TextureManager::isSameContent(*texture, *hash->second))
+                continue;
+            ++this->_contentHits;
+            ++this->_references.at(hash->second);
+            texture->setSource(hash->second);
+        }
+        LOG(INFO) << "TextureManager: " << textures.size() << " textures decoded on " << threadCount << " threads";
+    }
+
+    void TextureManager::packTextures(const vk::PhysicalDeviceMemoryProperties &memProperties, uint32_t maxLayers)
+    {
+        // Ordered, the layers do not depend on the hash map order
+        std::map<std::tuple<vk::Format, uint32_t, uint32_t, size_t>, std::vector<Texture *>> groups;
+        std::vector<const TextureFile *> files;
+        uint32_t layerCount;
+        size_t levelCount;
+
+        for (const auto &texture : this->_texturesPaths)
+        {
+            const TextureFile &file = texture.second->getFile();
+            if (texture.second->getSource() || texture.second->getArray() || !file.isLoaded() || std::max(file.getWidth(), file.getHeight()) > DWARF_PACKED_TEXTURE_SIZE)
+                continue;
+            // Grouped by the levels it will have, a single uncompressed level gets its full chain once packed
+            levelCount = file.isCompressed() || file.getLevels().size() != 1 ? file.getLevels().size() : TextureFile::getMipChainLength(file.getWidth(), file.getHeight());
+            groups[std::make_tuple(file.getFormat(), file.getWidth(), file.getHeight(), levelCount)].push_back(texture.second);
+        }
+        vk::Sampler sampler = this->_samplerCache.getSampler(Texture::getSamplerInfo());
+        for (const auto &group : groups)
+        {
+            for (size_t first = 0; first + 1 < group.second.size(); first += maxLayers)
+            {
+                layerCount = static_cast<uint32_t>(std::min(group.second.size() - first, static_cast<size_t>(maxLayers)));
+                files.clear();
+                for (uint32_t layer = 0; layer < layerCount; ++layer)
+                {
+                    // Layers cannot be blitted by the uploader, every level comes from the CPU
+                    group.second.at(first + layer)->generateMipmaps();
+                    files.push_back(&group.second.at(first + layer)->getFile());
+                }
+                this->_arrays.push_back(new TextureArray(this->_device, this->_textureUploader, sampler));
+                this->_arrays.back()->create(files, memProperties);
+                for (uint32_t layer = 0; layer < layerCount; ++layer)
+                    group.second.at(first + layer)->setArray(this->_arrays.back(), layer);
+                this->_packedTextures += layerCount;
+            }
+        }
+    }
+
+    void TextureManager::logStatistics() const
+    {
+        LOG(INFO) << "TextureManager: " << this->_texturesHashes.size() << " unique textures, " << this->_misses << " path misses, " << this->_pathHits << " path hits, " << this->_contentHits << " content hits, " << this->_packedTextures << " packed in " << this->_arrays.size() << " arrays";
+    }
+
+    bool TextureManager::isSameContent(const Texture &left, const Texture &right)
+    {
+        const TextureFile &leftFile = left.getFile();
+        const TextureFile &rightFile = right.getFile();
+
+        // An uploaded source has no data left to compare, it is then kept apart
+        return (leftFile.getFormat() == rightFile.getFormat() && leftFile.getWidth() == rightFile.getWidth() && leftFile.getHeight() == rightFile.getHeight()
+            && !leftFile.getData().empty() && leftFile.getData() == rightFile.getData());
+    }
+
+    std::string TextureManager::resolvePath(const std::string &textureName)
+    {
+        std::string path;
+
+        path.reserve(textureName.size());
+        for (size_t i = 0; i < textureName.size(); ++i)
+        {
+            char c = textureName.at(i) == '\\' ? '/' : textureName.at(i);
+            if (c == '/' && (path.empty() || path.back() == '/'))
+                continue;
+            path.push_back(c);
+            // Drop the "./" components
+            if (c == '/' && path.size() >= 2 && path.at(path.size() - 2) == '.' && (path.size() == 2 || path.at(path.size() - 3) == '/'))
+                path.resize(path.size() - 2);
+        }
+        return (path);
+    }
+}
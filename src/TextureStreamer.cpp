@@ -0,0 +1,218 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "CullingManager.h"
+
+// Closer than this the finest level is required whatever the density
+#define STREAMING_MIN_DISTANCE 0.01f
+
+namespace Dwarf
+{
+    TextureStreamer::TextureStreamer(TextureUploader &textureUploader, const vk::PhysicalDeviceMemoryProperties &memProperties, vk::DeviceSize budget)
+        : _textureUploader(textureUploader), _memProperties(memProperties), _budget(budget), _residentSize(0), _frameBytes(0), _frame(0), _streamedIn(0), _evicted(0)
+    {
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        // The device is idle, nothing still samples the previous images
+        for (auto &texture : this->_pending)
+            texture->commitStream();
+    }
+
+    void TextureStreamer::addSubmeshes(std::vector<Mesh *> &meshes)
+    {
+        std::unordered_map<Texture *, uint32_t> textureIndices;
+        StreamedSubmesh streamedSubmesh;
+        Texture *resolved;
+        float uvArea;
+        float posArea;
+
+        for (uint32_t i = 0; i < this->_textures.size(); ++i)
+            textureIndices[this->_textures.at(i).texture] = i;
+        for (auto &mesh : meshes)
+        {
+            for (auto &submesh : mesh->getSubmeshes())
+            {
+                if (!submesh.getMaterial())
+                    continue;
+                streamedSubmesh.submesh = &submesh;
+                streamedSubmesh.textures.clear();
+                for (auto &texture : submesh.getMaterial()->getTextures())
+                {
+                    if (!texture)
+                        continue;
+                    resolved = texture->getSource() ? texture->getSource() : texture;
+                    // Not streamed, its levels are not kept on the CPU
+                    if (resolved->getLevelCount() == 0)
+                        continue;
+                    auto index = textureIndices.find(resolved);
+                    if (index == textureIndices.end())
+                    {
+                        index = textureIndices.emplace(resolved, static_cast<uint32_t>(this->_textures.size())).first;
+                        this->_textures.push_back({ resolved, resolved->getResidentLevel(), 0 });
+                        this->_residentSize += resolved->getLevelsSize(resolved->getResidentLevel());
+                    }
+                    if (std::find(streamedSubmesh.textures.begin(), streamedSubmesh.textures.end(), index->second) == streamedSubmesh.textures.end())
+                        streamedSubmesh.textures.push_back(index->second);
+                }
+                if (streamedSubmesh.textures.empty())
+                    continue;
+                const std::vector<Vertex> &vertices = submesh.getVertices();
+                const std::vector<uint32_t> &indices = submesh.getIndices();
+                // The finest level of detail, the coarser ones follow it in the index buffer
+                size_t first = submesh.getLods().empty() ? 0 : submesh.getLods().front().firstIndex;
+                size_t count = submesh.getLods().empty() ? indices.size() : submesh.getLods().front().indexCount;
+                uvArea = 0.0f;
+                posArea = 0.0f;
+                for (size_t i = first; i + 2 < first + count; i += 3)
+                {
+                    const Vertex &a = vertices.at(indices.at(i));
+                    const Vertex &b = vertices.at(indices.at(i + 1));
+                    const Vertex &c = vertices.at(indices.at(i + 2));
+                    glm::vec2 uvB = b.uv - a.uv;
+                    glm::vec2 uvC = c.uv - a.uv;
+                    uvArea += std::abs(uvB.x * uvC.y - uvB.y * uvC.x) * 0.5f;
+                    posArea += glm::length(glm::cross(b.pos - a.pos, c.pos - a.pos)) * 0.5f;
+                }
+                streamedSubmesh.uvDensity = posArea > 0.0f ? std::sqrt(uvArea / posArea) : 0.0f;
+                this->_submeshes.push_back(streamedSubmesh);
+            }
+        }
+    }
+
+    void TextureStreamer::update(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, float fov, float viewportHeight)
+    {
+        std::vector<StreamedTexture *> candidates;
+        vk::DeviceSize size;
+        vk::DeviceSize growth;
+
+        if (!this->_pending.empty())
+        {
+            // One stream per texture at a time, planning waits for the previous images to be replaced
+            if (!this->_textureUploader.poll())
+                return;
+            for (auto &texture : this->_pending)
+                texture->commitStream();
+            this->_pending.clear();
+        }
+        ++this->_frame;
+        this->_frameBytes = 0;
+        this->computeRequiredLevels(viewProjection, cameraPosition, viewportHeight / (2.0f * std::tan(glm::radians(fov) * 0.5f)));
+        for (auto &streamedTexture : this->_textures)
+        {
+            if (streamedTexture.lastUsed == this->_frame && streamedTexture.requiredLevel < streamedTexture.texture->getResidentLevel())
+                candidates.push_back(&streamedTexture);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture *a, const StreamedTexture *b)
+        {
+            return (a->texture->getResidentLevel() - a->requiredLevel > b->texture->getResidentLevel() - b->requiredLevel);
+        });
+        for (auto &candidate : candidates)
+        {
+            size = candidate->texture->getLevelsSize(candidate->requiredLevel);
+            growth = size - candidate->texture->getLevelsSize(candidate->texture->getResidentLevel());
+            // A texture larger than the frame cap still goes through, alone
+            if (this->_frameBytes > 0 && this->_frameBytes + size > DWARF_STREAMING_FRAME_BYTES)
+                continue;
+            if (this->_residentSize + growth > this->_budget && !this->evict(growth))
+                continue;
+            this->stream(*candidate, candidate->requiredLevel);
+            ++this->_streamedIn;
+        }
+        if (!this->_pending.empty())
+            this->_textureUploader.submit();
+    }
+
+    void TextureStreamer::logStatistics() const
+    {
+        LOG(INFO) << "TextureStreamer: " << this->_textures.size() << " streamed textures, " << this->_residentSize / (1024 * 1024) << " MiB resident out of " << this->_budget / (1024 * 1024) << " MiB, " << this->_streamedIn << " streamed in, " << this->_evicted << " evicted";
+    }
+
+    void TextureStreamer::computeRequiredLevels(const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition, float lodScale)
+    {
+        std::array<glm::vec4, 6> frustumPlanes = CullingManager::extractFrustumPlanes(viewProjection);
+        glm::vec3 center;
+        float scale;
+        float radius;
+        float distance;
+        float texelsPerPixel;
+        uint32_t level;
+        bool visible;
+
+        for (const auto &streamedSubmesh : this->_submeshes)
+        {
+            const glm::mat4 &transform = streamedSubmesh.submesh->getTransform();
+            const glm::vec4 &boundingSphere = streamedSubmesh.submesh->getBoundingSphere();
+            center = glm::vec3(transform * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+            scale = std::max(std::max(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1]))), glm::length(glm::vec3(transform[2])));
+            radius = boundingSphere.w * scale;
+            visible = true;
+            for (const auto &plane : frustumPlanes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (!visible)
+                continue;
+            distance = std::max(glm::length(center - cameraPosition) - radius, STREAMING_MIN_DISTANCE);
+            for (auto index : streamedSubmesh.textures)
+            {
+                StreamedTexture &streamedTexture = this->_textures.at(index);
+                level = streamedTexture.texture->getBaseLevel();
+                if (streamedSubmesh.uvDensity > 0.0f)
+                {
+                    // Texels over pixels covered by one object unit, each level halves the texels
+                    texelsPerPixel = streamedTexture.texture->getFullWidth() * streamedSubmesh.uvDensity * distance / (scale * lodScale);
+                    level = texelsPerPixel > 1.0f ? std::min(static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))), level) : 0;
+                }
+                if (streamedTexture.lastUsed != this->_frame || level < streamedTexture.requiredLevel)
+                    streamedTexture.requiredLevel = level;
+                streamedTexture.lastUsed = this->_frame;
+            }
+        }
+    }
+
+    bool TextureStreamer::evict(vk::DeviceSize size)
+    {
+        std::vector<StreamedTexture *> victims;
+        uint32_t level;
+
+        for (auto &streamedTexture : this->_textures)
+        {
+            level = streamedTexture.lastUsed == this->_frame ? streamedTexture.requiredLevel : streamedTexture.texture->getBaseLevel();
+            if (streamedTexture.texture->getResidentLevel() < level && std::find(this->_pending.begin(), this->_pending.end(), streamedTexture.texture) == this->_pending.end())
+                victims.push_back(&streamedTexture);
+        }
+        std::sort(victims.begin(), victims.end(), [](const StreamedTexture *a, const StreamedTexture *b)
+        {
+            return (a->lastUsed < b->lastUsed);
+        });
+        for (auto &victim : victims)
+        {
+            if (this->_residentSize + size <= this->_budget)
+                break;
+            level = victim->lastUsed == this->_frame ? victim->requiredLevel : victim->texture->getBaseLevel();
+            this->stream(*victim, level);
+            ++this->_evicted;
+        }
+        return (this->_residentSize + size <= this->_budget);
+    }
+
+    void TextureStreamer::stream(StreamedTexture &streamedTexture, uint32_t level)
+    {
+        vk::DeviceSize size = streamedTexture.texture->getLevelsSize(level);
+
+        // Counted from now on, the previous image lives until the stream is committed
+        this->_residentSize = this->_residentSize - streamedTexture.texture->getLevelsSize(streamedTexture.texture->getResidentLevel()) + size;
+        this->_frameBytes += size;
+        streamedTexture.texture->stream(level, this->_memProperties);
+        this->_pending.push_back(streamedTexture.texture);
+    }
+}
@@ -0,0 +1,129 @@
+#include "TextureUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Dwarf
+{
+    TextureUploader::TextureUploader(const vk::Device &device, const vk::Queue &graphicsQueue, const vk::CommandPool &commandPool, const vk::PhysicalDeviceMemoryProperties &memProperties)
+        : _device(device), _graphicsQueue(graphicsQueue), _commandPool(commandPool), _memProperties(memProperties), _stagingData(nullptr), _stagingSize(0), _stagingOffset(0), _submitted(false), _pendingCount(0), _batchCount(0)
+    {
+        this->createStagingBuffer(DWARF_STAGING_BUFFER_SIZE);
+        this->_fence = this->_device.createFence(vk::FenceCreateInfo(), CUSTOM_ALLOCATOR);
+    }
+
+    TextureUploader::~TextureUploader()
+    {
+        this->flush();
+        this->_device.destroyFence(this->_fence, CUSTOM_ALLOCATOR);
+        this->destroyStagingBuffer();
+    }
+
+    void TextureUploader::upload(const vk::Image &image, const void *data, vk::DeviceSize size, std::vector<vk::BufferImageCopy> regions, uint32_t mipLevels, uint32_t layerCount)
+    {
+        this->wait();
+        // Offsets of block compressed copies are multiples of the block size, 16 covers every format in use
+        vk::DeviceSize offset = (this->_stagingOffset + 15) & ~static_cast<vk::DeviceSize>(15);
+        uint32_t copiedLevels = 0;
+
+        if (offset + size > this->_stagingSize)
+        {
+            this->flush();
+            offset = 0;
+            if (size > this->_stagingSize)
+            {
+                this->destroyStagingBuffer();
+                this->createStagingBuffer(size);
+            }
+        }
+        memcpy(this->_stagingData + offset, data, static_cast<size_t>(size));
+        this->_stagingOffset = offset + size;
+        if (!this->_commandBuffer)
+            this->_commandBuffer = Tools::beginSingleTimeCommands(this->_device, this->_commandPool);
+        for (auto &region : regions)
+        {
+            region.bufferOffset += offset;
+            copiedLevels = std::max(copiedLevels, region.imageSubresource.mipLevel + 1);
+        }
+
+        // The previous content is discarded, the image can come straight from creation
+        vk::ImageMemoryBarrier barrier(vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, layerCount));
+        this->_commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier);
+        this->_commandBuffer.copyBufferToImage(this->_stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, regions);
+        if (copiedLevels < mipLevels)
+            Tools::recordMipmaps(this->_commandBuffer, image, regions.front().imageExtent.width, regions.front().imageExtent.height, mipLevels);
+        else
+        {
+            barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+            barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+            barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+            barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+            this->_commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        ++this->_pendingCount;
+    }
+
+    void TextureUploader::flush()
+    {
+        this->submit();
+        this->wait();
+    }
+
+    void TextureUploader::submit()
+    {
+        vk::SubmitInfo submitInfo;
+
+        if (!this->_commandBuffer || this->_submitted)
+            return;
+        this->_commandBuffer.end();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &this->_commandBuffer;
+        this->_graphicsQueue.submit(submitInfo, this->_fence);
+        this->_submitted = true;
+        LOG(INFO) << "TextureUploader: batch " << ++this->_batchCount << " of " << this->_pendingCount << " images, " << this->_stagingOffset << " bytes";
+    }
+
+    bool TextureUploader::poll()
+    {
+        if (!this->_submitted)
+            return (true);
+        if (this->_device.getFenceStatus(this->_fence) != vk::Result::eSuccess)
+            return (false);
+        this->complete();
+        return (true);
+    }
+
+    void TextureUploader::wait()
+    {
+        if (!this->_submitted)
+            return;
+        this->_device.waitForFences(this->_fence, VK_TRUE, UINT64_MAX);
+        this->complete();
+    }
+
+    void TextureUploader::complete()
+    {
+        this->_device.resetFences(this->_fence);
+        this->_device.freeCommandBuffers(this->_commandPool, this->_commandBuffer);
+        this->_commandBuffer = vk::CommandBuffer();
+        this->_submitted = false;
+        this->_stagingOffset = 0;
+        this->_pendingCount = 0;
+    }
+
+    void TextureUploader::createStagingBuffer(vk::DeviceSize size)
+    {
+        Tools::createBuffer(this->_device, this->_memProperties, size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, this->_stagingBuffer, this->_stagingBufferMemory);
+        this->_stagingData = static_cast<unsigned char *>(this->_device.mapMemory(this->_stagingBufferMemory, 0, size));
+        this->_stagingSize = size;
+    }
+
+    void TextureUploader::destroyStagingBuffer()
+    {
+        this->_device.unmapMemory(this->_stagingBufferMemory);
+        this->_device.destroyBuffer(this->_stagingBuffer, CUSTOM_ALLOCATOR);
+        this->_device.freeMemory(this->_stagingBufferMemory, CUSTOM_ALLOCATOR);
+        this->_stagingData = nullptr;
+        this->_stagingSize = 0;
+    }
+}
@@ -1,5 +1,7 @@
 #include "Tools.h"
 
+#include <algorithm>
+
 namespace Dwarf
 {
 	namespace Tools
@@ -73,9 +75,19 @@ namespace Dwarf
 			return (0);
 		}
 
-		void createImage(const vk::Device &device, vk::PhysicalDeviceMemoryProperties memProperties, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory)
+		void createBuffer(const vk::Device &device, const vk::PhysicalDeviceMemoryProperties &memProperties, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory)
 		{
-			vk::ImageCreateInfo imageInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, format, vk::Extent3D(width, height, 1), 1, 1, vk::SampleCountFlagBits::e1, tiling, usage, vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::ePreinitialized);
+			vk::BufferCreateInfo bufferInfo(vk::BufferCreateFlags(), size, usage);
+			buffer = device.createBuffer(bufferInfo, CUSTOM_ALLOCATOR);
+			vk::MemoryRequirements memRequirements = device.getBufferMemoryRequirements(buffer);
+			vk::MemoryAllocateInfo allocInfo(memRequirements.size, getMemoryType(memProperties, memRequirements.memoryTypeBits, properties));
+			bufferMemory = device.allocateMemory(allocInfo, CUSTOM_ALLOCATOR);
+			device.bindBufferMemory(buffer, bufferMemory, 0);
+		}
+
+		void createImage(const vk::Device &device, vk::PhysicalDeviceMemoryProperties memProperties, uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory, uint32_t mipLevels, uint32_t arrayLayers)
+		{
+			vk::ImageCreateInfo imageInfo(vk::ImageCreateFlags(), vk::ImageType::e2D, format, vk::Extent3D(width, height, 1), mipLevels, arrayLayers, vk::SampleCountFlagBits::e1, tiling, usage, vk::SharingMode::eExclusive, 0, nullptr, vk::ImageLayout::ePreinitialized);
 			image = device.createImage(imageInfo, CUSTOM_ALLOCATOR);
 			// TODO: Write a sub allocator for image memory
 			vk::MemoryRequirements memRequirements = device.getImageMemoryRequirements(image);
@@ -94,21 +106,60 @@ namespace Dwarf
 			endSingleTimeCommands(device, queue, commandPool, commandBuffer);
 		}
 
-		void createImageView(const vk::Device &device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, vk::ImageView &imageView)
+		void recordMipmaps(const vk::CommandBuffer &commandBuffer, vk::Image image, uint32_t width, uint32_t height, uint32_t mipLevels)
 		{
-			vk::ImageViewCreateInfo viewInfo(vk::ImageViewCreateFlags(), image, vk::ImageViewType::e2D, format);
-			viewInfo.subresourceRange = vk::ImageSubresourceRange(aspectFlags, 0, 1, 0, 1);
+			vk::ImageMemoryBarrier barrier;
+			int32_t levelWidth = static_cast<int32_t>(width);
+			int32_t levelHeight = static_cast<int32_t>(height);
+
+			barrier.image = image;
+			barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+			for (uint32_t level = 1; level < mipLevels; ++level)
+			{
+				// The previous level becomes the source of this blit, then is done for good
+				barrier.subresourceRange.baseMipLevel = level - 1;
+				barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+				barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+				barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+				barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+				commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier);
+				vk::ImageBlit blit;
+				blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1);
+				blit.srcOffsets[1] = vk::Offset3D(levelWidth, levelHeight, 1);
+				levelWidth = std::max(levelWidth / 2, 1);
+				levelHeight = std::max(levelHeight / 2, 1);
+				blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+				blit.dstOffsets[1] = vk::Offset3D(levelWidth, levelHeight, 1);
+				commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+				barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+				barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+				barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+				barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+				commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+			barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+			barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+			barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		void createImageView(const vk::Device &device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, vk::ImageView &imageView, uint32_t baseMipLevel, uint32_t levelCount, vk::ImageViewType viewType, uint32_t layerCount)
+		{
+			vk::ImageViewCreateInfo viewInfo(vk::ImageViewCreateFlags(), image, viewType, format);
+			viewInfo.subresourceRange = vk::ImageSubresourceRange(aspectFlags, baseMipLevel, levelCount, 0, layerCount);
 			imageView = device.createImageView(viewInfo, CUSTOM_ALLOCATOR);
 		}
 
-		void transitionImageLayout(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+		void transitionImageLayout(const vk::Device &device, const vk::Queue &queue, const vk::CommandPool &commandPool, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels)
 		{
 			vk::CommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 			vk::ImageMemoryBarrier barrier;
 			barrier.setOldLayout(oldLayout);
 			barrier.setNewLayout(newLayout);
 			barrier.image = image;
-			barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+			barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1));
 			if (newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
 				barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
 			if (oldLayout == vk::ImageLayout::ePreinitialized && newLayout == vk::ImageLayout::eTransferSrcOptimal)
@@ -121,11 +172,21 @@ namespace Dwarf
 				barrier.setSrcAccessMask(vk::AccessFlagBits::eHostWrite);
 				barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
 			}
+			else if (oldLayout == vk::ImageLayout::ePreinitialized && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+			{
+				barrier.setSrcAccessMask(vk::AccessFlagBits::eHostWrite);
+				barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			}
 			else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
 			{
 				barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
 				barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
 			}
+			else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eGeneral)
+			{
+				barrier.setSrcAccessMask(vk::AccessFlags());
+				barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			}
 			else if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
 			{
 				barrier.setSrcAccessMask(vk::AccessFlags());